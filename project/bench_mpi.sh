@@ -0,0 +1,148 @@
+#!/bin/bash
+#
+# This script measures how the partitioning schemes scale. It runs on a
+# single machine with mpirun, so it does not need SLURM; inside a SLURM
+# allocation, set MPIRUN="srun" instead.
+#
+# For every scene and image size, the scene is first rendered with
+# -p none on one process. That render is the reference image and its time
+# is the baseline. Every partitioning scheme is then run with every number
+# of processes (and every cycle size or block size, for the schemes that
+# take one). Each point is repeated, and every image is checked against
+# the reference with png_compare.
+#
+# Every run is written to a CSV file with these columns:
+#
+#   scene,width,height,mode,parameter,procs,repeat,seconds,match
+#
+# When the sweep is done, a table of the best time, the speedup over the
+# baseline and the efficiency (speedup / processes) is printed for every
+# scheme. The script exits with 1 if any image did not match.
+#
+# Everything can be changed through environment variables, e.g.
+#
+#   PROCS="2 4 8" MODES="dynamic static_cycles_horizontal" ./bench_mpi.sh
+#
+# Run `make' first.
+
+SCENES=${SCENES:-"configs/twhitted.xml configs/box.xml"}
+SIZES=${SIZES:-"400x300 800x600"}
+PROCS=${PROCS:-"1 2 4"}
+MODES=${MODES:-"static_strips_horizontal static_strips_vertical static_blocks static_cycles_horizontal static_cycles_vertical dynamic work_stealing static_cost"}
+CYCLES=${CYCLES:-"1 8"}
+BLOCKS=${BLOCKS:-"8 32"}
+REPEATS=${REPEATS:-3}
+MPIRUN=${MPIRUN:-"mpirun --oversubscribe"}
+OUT=${OUT:-"bench/results-$(date +%Y%m%d-%H%M%S).csv"}
+
+mkdir -p "$(dirname "$OUT")" renders
+echo "scene,width,height,mode,parameter,procs,repeat,seconds,match" > "$OUT"
+
+# Runs the ray tracer and prints the execution time and the image it saved.
+render()
+{
+    local procs=$1
+    shift
+    local output
+    # mpirun hands its stdin to rank 0, which would eat the list of
+    # parameters that the sweep reads from a pipe.
+    output=$($MPIRUN -n "$procs" ./raytrace_mpi "$@" < /dev/null 2> /dev/null)
+    local seconds=$(echo "$output" | sed -n 's/^Execution Time: \([0-9.e+-]*\) seconds.*/\1/p' | head -1)
+    local image=$(echo "$output" | sed -n 's/^Image will be save to: //p' | head -1)
+
+    # Images are named after the second they were saved in, so the next run
+    # could write over this one. Give it a name of its own next to $OUT.
+    if [ -n "$image" ] && [ -f "$image" ]; then
+        local unique=$(mktemp "$(dirname "$OUT")/render.XXXXXX")
+        mv "$image" "$unique"
+        image=$unique
+    fi
+    echo "${seconds:-NaN} $image"
+}
+
+# Prints the parameters that go with a scheme, as "name:arguments".
+parameters()
+{
+    case $1 in
+        static_cycles_horizontal|static_cycles_vertical)
+            for cycle in $CYCLES; do echo "cs$cycle:-cs $cycle"; done ;;
+        dynamic|work_stealing)
+            for block in $BLOCKS; do echo "b$block:-bw $block -bh $block"; done ;;
+        *)
+            echo "-:" ;;
+    esac
+}
+
+for scene in $SCENES; do
+    name=$(basename "$scene" .xml)
+    for size in $SIZES; do
+        width=${size%x*}
+        height=${size#*x}
+        common="-c $scene -w $width -h $height"
+
+        # The sequential render is both the baseline and the reference.
+        reference=""
+        for repeat in $(seq 1 "$REPEATS"); do
+            read seconds image <<< "$(render 1 $common -p none)"
+            if [ -z "$reference" ]; then
+                reference="$image"
+            else
+                rm -f "$image"
+            fi
+            echo "$name,$width,$height,none,-,1,$repeat,$seconds,yes" >> "$OUT"
+        done
+        echo "$name $width x $height: reference $reference" >&2
+
+        for mode in $MODES; do
+            for procs in $PROCS; do
+                # The dynamic schemes need a master and at least one slave.
+                if [ "$procs" -lt 2 ] && { [ "$mode" = dynamic ] || [ "$mode" = work_stealing ]; }; then
+                    continue
+                fi
+                parameters "$mode" | while IFS=: read parameter arguments; do
+                    for repeat in $(seq 1 "$REPEATS"); do
+                        read seconds image <<< "$(render "$procs" $common -p "$mode" $arguments)"
+                        match=no
+                        if [ -n "$image" ] && ./png_compare -list 0 "$reference" "$image" > /dev/null; then
+                            match=yes
+                        fi
+                        rm -f "$image"
+                        echo "$name,$width,$height,$mode,$parameter,$procs,$repeat,$seconds,$match" >> "$OUT"
+                        echo "$name $width x $height $mode $parameter -n $procs #$repeat: $seconds s, match $match" >&2
+                    done
+                done
+            done
+        done
+        rm -f "$reference"
+    done
+done
+
+# Print the best time of every point against the best sequential time.
+echo
+echo "Results: $OUT"
+awk -F, '
+    NR == 1 { next }
+    {
+        key = $1 "," $2 "," $3 "," $4 "," $5 "," $6
+        if (!(key in best) || $8 < best[key]) { best[key] = $8 }
+        if ($9 != "yes") { failed[key]++ }
+        if (!(key in seen)) { seen[key] = 1; order[++count] = key }
+        if ($4 == "none" && (!(($1 "," $2 "," $3) in baseline) || $8 < baseline[$1 "," $2 "," $3])) {
+            baseline[$1 "," $2 "," $3] = $8
+        }
+    }
+    END {
+        printf "%-10s %-10s %-26s %-6s %6s %10s %9s %11s %s\n", "Scene", "Size", "Mode", "Param", "Procs", "Best (s)", "Speedup", "Efficiency", "Mismatches"
+        for (i = 1; i <= count; i++) {
+            split(order[i], f, ",")
+            base = baseline[f[1] "," f[2] "," f[3]]
+            speedup = best[order[i]] > 0 ? base / best[order[i]] : 0
+            printf "%-10s %-10s %-26s %-6s %6d %10.4f %9.2f %10.1f%% %d\n", f[1], f[2] "x" f[3], f[4], f[5], f[6], best[order[i]], speedup, 100 * speedup / f[6], failed[order[i]]
+        }
+    }' "$OUT"
+
+failures=$(awk -F, 'NR > 1 && $9 != "yes"' "$OUT" | wc -l)
+if [ "$failures" -gt 0 ]; then
+    echo "$failures runs did not match the sequential render!"
+    exit 1
+fi
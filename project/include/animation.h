@@ -0,0 +1,69 @@
+#ifndef __ANIMATION_H__
+#define __ANIMATION_H__
+
+#include <string>
+
+#include "RayTrace.h"
+
+//With -frames <file>, several frames are rendered in one run. The file
+//lists keyframes for the camera, one per line:
+//
+//    frame eyeX eyeY eyeZ lookAtX lookAtY lookAtZ
+//
+//Lines that start with # are ignored. Every frame from the first keyframe
+//to the last is rendered, with the eye point and the point that the camera
+//looks at interpolated linearly between the keyframes.
+//
+//The library moves the models into the space of the camera while it loads
+//them, so the camera cannot be changed in a loaded scene. Every copy of the
+//scene is loaded again for each frame that moves the camera, from a copy of
+//the configuration file with the camera moved, which reads the staged files
+//on the local node instead of the originals. The processes, the threads and
+//the staged files stay up for the whole animation, and the master encodes
+//and writes each frame in the background while the next one renders. The
+//pixels of a frame are still gathered before the next one starts.
+
+//This function will read the keyframes and the configuration file. Every
+//process must call this before the staged scene files are removed.
+//
+//Inputs:
+//    data - the ConfigData that holds the scene information.
+//
+//Outputs:
+//    The number of frames to render, 1 without -frames, or 0 if there was
+//    an error in the processing.
+int startAnimation(ConfigData* data);
+
+//This function will load every copy of the scene again with the camera
+//where it is in the given frame. It does nothing without -frames, or when
+//the camera is already there. Every
+//process must call this before rendering each frame.
+//
+//Inputs:
+//    data - the ConfigData that holds the scene information.
+//    frame - the frame, counting from 0.
+//
+//Outputs:
+//    true if there was an error in the processing; otherwise, false
+bool setFrame(ConfigData* data, int frame);
+
+//This function will return the name of the file that the current frame is
+//saved to, including the ".png" extension.
+std::string frameFileName();
+
+//This function will save the image of a frame. With -frames, the image is
+//encoded and written by a background thread while the next frame renders,
+//and the pixels are deleted once they have been written. Otherwise it is
+//saved with savePixels() right away.
+//
+//Inputs:
+//    file - the name of the file to save.
+//    pixels - the image, allocated with new[]. It is owned by this function.
+//    data - the ConfigData that holds the scene information.
+void saveFrame(std::string file, float* pixels, ConfigData* data);
+
+//This function will wait for the last frame to be written. Every process
+//must call this after rendering.
+void finishAnimation();
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef __ANTIALIAS_H__
+#define __ANTIALIAS_H__
+
+#include "RayTrace.h"
+
+//shadePixel() can only shade whole pixels, so the extra samples for
+//anti-aliasing come from a second copy of the scene that is loaded at
+//renderOptions.antialiasing times the width and height of the image. Pixel
+//(row, column) of the image covers pixels (k * row + i, k * column + j),
+//0 <= i, j < k, of the larger one, which are the k x k samples that get
+//averaged.
+
+//This function will load the scene that the extra samples are taken from,
+//if -aa was given. Every process must call this after initialize().
+//
+//Inputs:
+//    data - the ConfigData that holds the scene information.
+//
+//Outputs:
+//    true if there was an error in the processing; otherwise, false
+bool startAntialiasing(ConfigData* data);
+
+//This function will clean up the scene that was loaded for the samples.
+void stopAntialiasing();
+
+//This function will anti-alias the edges of the image that was rendered
+//with one sample per pixel. The master finds the pixels whose brightness
+//differs from one of their neighbours by more than the -aa-threshold, and
+//the pixels are then dealt out to every process, which shades k x k samples
+//for each of them. The master puts the averages back into the image and
+//prints how many pixels were refined. Every process must call this after
+//rendering.
+//
+//Inputs:
+//    data - the ConfigData that holds the scene information.
+//    pixels - the image on the master; ignored on the slaves.
+void refineEdges(ConfigData* data, float* pixels);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef __BALANCE_H__
+#define __BALANCE_H__
+
+#include <vector>
+
+#include "RayTrace.h"
+#include "tiles.h"
+
+//This function will split the image into one block per process so that
+//every block should take about the same time to shade. Every process first
+//shades one sample pixel out of every renderOptions.sampleStep x
+//sampleStep cell of the image and times it, the timings are shared between
+//all of the processes, and then the image is split in two again and again
+//(recursive bisection) along the longer side of each piece, at the line
+//that gives both halves a share of the estimated cost that matches the
+//number of processes they get. Every process must call this, and they all
+//end up with the same blocks.
+//
+//Inputs:
+//    data - the ConfigData that holds the scene information.
+//    blocks - receives the block of every process, indexed by rank. A
+//        block can be empty when there are more processes than pixels.
+//    predicted - receives the estimated shading time of every block in
+//        seconds.
+void balancedBlocks(ConfigData* data, std::vector<Tile>* blocks, std::vector<double>* predicted);
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include "RayTrace.h"
+
+//With -checkpoint <seconds>, every process saves the pixels that it shades
+//to a checkpoint file in renders/ as it goes, and with -resume <file> a
+//render takes the pixels that an earlier run already saved from the file
+//instead of shading them again. The file is laid out like the image:
+//
+//    header - the magic "RTCKPT01", the width and height of the image and
+//        the colors of a few pixels, which tell the scene and camera apart.
+//    map - one byte per pixel, row by row, that is 1 once the pixel has
+//        been saved. A byte is used rather than a bit so that processes
+//        that shade neighbouring pixels never write to the same byte.
+//    pixels - three floats per pixel, row by row, as they were shaded
+//        (before anti-aliasing and tone mapping).
+//
+//Every process writes its own pixels straight into the file, so the file
+//does not depend on which process shaded what, and a render can be
+//resumed with any partitioning scheme and any number of processes. The
+//pixels are handed to a thread that writes them in the background every
+//few seconds, so shading never waits on the disk. The thread writes the
+//pixels, waits for them to reach the disk, and only then marks them in the
+//map, so the map never claims a pixel that the file does not have.
+//
+//Every pixel of the image goes through shadeRegion(), which takes the
+//pixels that are in the map from the file and only shades the rest. The
+//checkpoint is removed once the image has been saved.
+
+//This function will create the checkpoint file on the master, or check
+//that the one given with -resume was made for the same image, and open it
+//on every process. It does nothing without -checkpoint or -resume. Every
+//process must call this before rendering.
+//
+//Inputs:
+//    data - the ConfigData that holds the scene information.
+//
+//Outputs:
+//    true if there was an error in the processing; otherwise, false
+bool startCheckpoint(ConfigData* data);
+
+//This function will write whatever has not been written yet and close the
+//checkpoint. The master removes the file once every process has closed
+//it. Every process must call this after the image has been saved.
+//
+//Inputs:
+//    data - the ConfigData that holds the scene information.
+void finishCheckpoint(ConfigData* data);
+
+//This function will queue a run of shaded pixels in one row to be written
+//to the checkpoint. It can be called from any thread.
+//
+//Inputs:
+//    pixels - the 3 * width color values of the run.
+//    row - the row of the image.
+//    firstColumn - the first column of the run.
+//    width - the number of pixels in the run.
+void checkpointPixels(const float* pixels, int row, int firstColumn, int width);
+
+//This function will read the pixels of a run in one row that an earlier
+//run already shaded. It can be called from any thread.
+//
+//Inputs:
+//    out - the buffer that receives the 3 * width color values. Only the
+//        pixels that are in the checkpoint are written.
+//    row - the row of the image.
+//    firstColumn - the first column of the run.
+//    width - the number of pixels in the run.
+//    finished - receives width values that are 1 for every pixel that
+//        was read and 0 for every pixel that still has to be shaded.
+void restorePixels(float* out, int row, int firstColumn, int width, unsigned char* finished);
+
+//This function will return true if an earlier run already shaded the given
+//pixel, so that it costs next to nothing to render.
+bool pixelRestored(int row, int column);
+
+#endif
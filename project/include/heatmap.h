@@ -0,0 +1,65 @@
+#ifndef __HEATMAP_H__
+#define __HEATMAP_H__
+
+#include <string>
+
+#include "RayTrace.h"
+#include "tiles.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+//The cost of every pixel of the image in timer ticks, or NULL when no heatmap
+//was asked for with -heatmap. Every process keeps a whole image of costs
+//and only fills in the pixels that it shades.
+extern float* costMap;
+
+//True to time every pixel, false to time whole regions passed to
+//shadeRegion() and spread the time evenly over their pixels.
+extern bool costPerPixel;
+
+//This function will read the timer that is used for the heatmap. It reads
+//the time stamp counter where there is one, which only takes a few cycles.
+//
+//Outputs:
+//    The current time in ticks.
+inline unsigned long long readTicks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+//This function will set up the cost map if -heatmap was given. It must be
+//called before rendering.
+//
+//Inputs:
+//    data - the ConfigData that holds the size of the image.
+void startHeatmap(ConfigData* data);
+
+//This function will take the cost of a region back out of the cost map, for
+//pixels that were shaded but did not go into the image.
+//
+//Inputs:
+//    data - the ConfigData that holds the size of the image.
+//    region - the pixels to clear.
+void discardCost(ConfigData* data, Tile region);
+
+//This function will add up the cost maps of every process on the master and
+//save them next to the render: a PNG image that goes from black (cheap)
+//through red and yellow to white (the 99th percentile of the costs), and a CSV file
+//with the cost of every pixel in microseconds, one row of the image per
+//line. Every process must call this after rendering.
+//
+//Inputs:
+//    data - the ConfigData that holds the size of the image.
+//    file - the name of the render, only used by the master.
+void finishHeatmap(ConfigData* data, std::string file);
+
+#endif
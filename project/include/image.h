@@ -0,0 +1,55 @@
+#ifndef __IMAGE_H__
+#define __IMAGE_H__
+
+#include <string>
+
+#include "RayTrace.h"
+
+//Holds the state of an image that is being written to disk one row at a
+//time. Use openImage() to create one.
+typedef struct ImageWriter ImageWriter;
+
+//This function will convert one color channel to the 8-bit value that is
+//saved in the image. This is the same conversion that savePixels() uses.
+//
+//Inputs:
+//    value - the color channel, 1.0 is full intensity.
+//
+//Outputs:
+//    The 8-bit value.
+inline unsigned char channelToByte(float value)
+{
+    return value > 1.0f ? 255 : (unsigned char)(int)(value * 255.0f);
+}
+
+//This function will open an image file that the rows of the image can be
+//written to from top to bottom as they are finished. The format is picked
+//from the extension of the filename: ".ppm" writes a binary PPM file and
+//everything else writes a PNG file. The rows that were written are flushed
+//to disk as they are written, so a render that is stopped early still
+//leaves the top of the image behind.
+//
+//Inputs:
+//    filename - the name of the file to write.
+//    data - the ConfigData that holds the size of the image.
+//
+//Outputs:
+//    The writer, or NULL if the file could not be opened.
+ImageWriter* openImage(std::string filename, ConfigData* data);
+
+//This function will write the next rows of the image.
+//
+//Inputs:
+//    image - the writer returned by openImage().
+//    pixels - the float RGB values of the rows, one row after another.
+//    rows - the number of rows to write.
+void writeRows(ImageWriter* image, float* pixels, int rows);
+
+//This function will finish the image and close the file. Every row of the
+//image must have been written.
+//
+//Inputs:
+//    image - the writer returned by openImage().
+void closeImage(ImageWriter* image);
+
+#endif
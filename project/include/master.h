@@ -2,6 +2,7 @@
 #define __MASTER_PROCESS_H__
 
 #include "RayTrace.h"
+#include "image.h"
 
 //This function is the main that only the master process
 //will run.
@@ -21,17 +22,78 @@ void masterMain( ConfigData *data );
 //Outputs: None
 void masterSequential(ConfigData *data, float* pixels);
 
+//This function will perform ray tracing when static horizontal strips
+//are used. Each process renders one strip of consecutive rows.
+//
+//Inputs:
+//    data - the ConfigData that holds the scene information.
+void masterStaticStripsHorizontal(ConfigData *data, float* pixels);
+
 //This function will perform ray tracing when static vertical strips
-//are used.
+//are used. Each process renders one strip of consecutive columns. The
+//strips and blocks of the slaves are received in bands while the master
+//renders its own (see bandRows()).
+//
+//Inputs:
+//    data - the ConfigData that holds the scene information.
+void masterStaticStripsVertical(ConfigData *data, float* pixels);
+
+//This function will perform ray tracing when static horizontal cycles
+//are used. The rows are dealt out to the processes cycleSize rows at
+//a time.
+//
+//Inputs:
+//    data - the ConfigData that holds the scene information.
+void masterStaticCyclesHorizontal(ConfigData *data, float* pixels);
+
+//This function will perform ray tracing when static vertical cycles
+//are used. The columns are dealt out to the processes cycleSize
+//columns at a time.
 //
 //Inputs:
 //    data - the ConfigData that holds the scene information.
 void masterStaticCyclesVertical(ConfigData *data, float* pixels);
 
 //This function will perform ray tracing when static blocks
-//are used.
+//are used. The processes are arranged in a grid and each one
+//renders one block of the image.
 //
 //Inputs:
 //    data - the ConfigData that holds the scene information.
 void masterStaticBlocks(ConfigData *data, float* pixels);
+
+//This function will perform ray tracing when dynamic partitioning
+//is used. The master hands out tiles of dynamicBlockWidth x
+//dynamicBlockHeight pixels to the slaves as they finish their
+//previous ones and does not render anything itself. Once every tile has
+//been handed out, slaves that run out of work are given copies of tiles
+//that are running far past the median time on the slaves that hold them,
+//and the first copy that comes back is used.
+//
+//Inputs:
+//    data - the ConfigData that holds the scene information.
+//    pixels - the image, or NULL to only keep a window of rows in
+//        memory and write each row to the stream once it is complete.
+//    stream - the image file that the rows are written to when pixels
+//        is NULL.
+void masterDynamic(ConfigData *data, float* pixels, ImageWriter* stream);
+
+//This function will perform ray tracing when work stealing is used.
+//Every process starts with a contiguous share of the tiles and takes
+//work from the others once it runs out. The tiles are only sent to the
+//master once everything has been rendered.
+//
+//Inputs:
+//    data - the ConfigData that holds the scene information.
+void masterWorkStealing(ConfigData *data, float* pixels);
+
+//This function will perform ray tracing when static cost partitioning is
+//used. Every process gets one block of the image, sized so that the blocks
+//should take the same time to shade according to a timed prepass (see
+//balancedBlocks()). The predicted and actual shading time of every block
+//is printed.
+//
+//Inputs:
+//    data - the ConfigData that holds the scene information.
+void masterStaticCost(ConfigData *data, float* pixels);
 #endif
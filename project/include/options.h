@@ -0,0 +1,113 @@
+#ifndef __OPTIONS_H__
+#define __OPTIONS_H__
+
+#include "RayTrace.h"
+#include "tiles.h"
+#include "wire.h"
+
+//Partitioning modes that are handled by this program on top of the ones
+//that the library knows about. They are stored in the partitioningMode
+//field of the ConfigData struct just like the library's own modes.
+#define PART_MODE_WORK_STEALING ((PartType)64)
+#define PART_MODE_STATIC_COST ((PartType)128)
+
+//Define a structure that holds the command line options that the
+//library's initialize() function does not know about.
+typedef struct
+{
+    //The partitioning mode to use instead of the one that was handed to
+    //the library, or PART_MODE_NONE to keep the library's choice.
+    PartType partitioningMode;
+
+    //The number of threads that shade pixels within each process.
+    int threads;
+
+    //The format ("png" or "ppm") of the image that the master writes one
+    //row at a time while rendering, or NULL to save the image at the end.
+    const char* streamFormat;
+
+    //The format that the slaves send their pixels to the master in.
+    WireFormat wireFormat;
+
+    //The format ("json" or "csv") that the timing of every process is
+    //printed in after the usual report, or NULL for only the usual report.
+    const char* reportFormat;
+
+    //How finely ("pixel" or "tile") the cost of the pixels is timed for the
+    //heatmap that is saved next to the render, or NULL for no heatmap.
+    const char* heatmapMode;
+
+    //The size of the cells that one pixel is timed from when estimating
+    //the cost of the image for the static cost scheme.
+    int sampleStep;
+
+    //The node-local directory that the scene files are copied to before
+    //they are loaded, or NULL to load them from where they are.
+    const char* stageDirectory;
+
+    //The file that the bundled scene files are cached in between runs, or
+    //NULL to read the scene files every time.
+    const char* sceneCache;
+
+    //The number of samples per side (k x k in all) that are taken for the
+    //pixels on edges, or 1 for no anti-aliasing, and how much the
+    //brightness (0 to 1) of a pixel has to differ from one of its
+    //neighbours for it to count as an edge.
+    int antialiasing;
+    float antialiasingThreshold;
+
+    //The file that lists the keyframes of the camera when rendering several
+    //frames, or NULL to render a single image.
+    const char* framesFile;
+
+    //The operator ("reinhard" or "ward") that the image is tone mapped
+    //with, or NULL to save the image as it is shaded. Reinhard's operator
+    //maps the log-average luminance to toneKey, and Ward's assumes that a
+    //display of toneDisplay cd/m2 shows the image.
+    const char* toneOperator;
+    float toneKey;
+    float toneDisplay;
+
+    //How often, in seconds, every process writes the pixels it has shaded
+    //to the checkpoint, or 0 for no checkpoint, and the checkpoint that an
+    //earlier run left to take the finished pixels from, or NULL.
+    float checkpointSeconds;
+    const char* resumeFile;
+
+    //The order that the tiles of the dynamic and work stealing schemes are
+    //handed out in, and that every process works through the cells of the
+    //regions it shades in (see shadeRegion()).
+    TileOrder tileOrder;
+
+    //The arguments that were left for initialize(), kept so that more
+    //copies of the scene can be loaded later on.
+    int sceneArgc;
+    char** sceneArgv;
+} RenderOptions;
+
+//The options for this run. These are filled in by parseRenderOptions().
+extern RenderOptions renderOptions;
+
+//This function will pull the options that are described in the
+//RenderOptions struct out of the command line, so that the remaining
+//arguments can be handed to initialize(). Partitioning schemes that the
+//library does not know about are replaced by one that it does know about
+//and that requires the same parameters.
+//
+//Inputs:
+//    argc - The pointer to the number of input arguments
+//    argv - The pointer to the input arguments
+//
+//Outputs:
+//    true if there was an error in the processing; otherwise, false
+bool parseRenderOptions(int* argc, char** argv[]);
+
+//This function will apply the options that were parsed by
+//parseRenderOptions() to the ConfigData struct. It must be called after
+//initialize() has filled in the struct.
+//
+//Inputs:
+//    data - The pointer to the ConfigData struct to update.
+void applyRenderOptions(ConfigData* data);
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef __PARTITION_H__
+#define __PARTITION_H__
+
+#include <mpi.h>
+
+#include "RayTrace.h"
+#include "tiles.h"
+
+//This function will return the first line (row or column) of the strip
+//that belongs to the given process when the lines are split into one strip
+//per process. The strips differ in size by at most one line; process rank
+//owns the lines stripStart(rank) <= line < stripStart(rank + 1).
+//
+//Inputs:
+//    lines - the total number of rows or columns in the image.
+//    procs - the number of processes.
+//    rank - the process to get the strip for, 0 <= rank <= procs.
+//
+//Outputs:
+//    The first line of the strip.
+int stripStart(int lines, int procs, int rank);
+
+//This function will return the number of lines (rows or columns) that
+//belong to the given process when the lines are dealt out to the processes
+//in cycles of cycleSize lines. Process rank owns the cycles that start at
+//lines (rank + k * procs) * cycleSize.
+//
+//Inputs:
+//    lines - the total number of rows or columns in the image.
+//    cycleSize - the number of lines in a cycle.
+//    procs - the number of processes.
+//    rank - the process to count the lines for.
+//
+//Outputs:
+//    The number of lines.
+int cycleLines(int lines, int cycleSize, int procs, int rank);
+
+//This function will return the block of the image that belongs to the
+//given process in the static blocks scheme. The processes are arranged in
+//a grid that is as close to square as possible (see MPI_Dims_create), and
+//the rows and columns are split evenly between the rows and columns of
+//the grid.
+//
+//Inputs:
+//    data - the ConfigData that holds the scene information.
+//    rank - the process to get the block for.
+//
+//Outputs:
+//    The block.
+Tile blockAt(ConfigData* data, int rank);
+
+//In the static strips and blocks schemes, every process renders one region
+//of the image and sends it to the master in bands of rows, so that a band
+//is on its way while the next one is being shaded. This function will
+//return the number of rows in each band of a region; the last band may be
+//shorter. When tone mapping, no pixel can be sent until the luminance of
+//the whole image is known, so the region is sent as a single band.
+//
+//Inputs:
+//    rows - the number of rows in the region.
+//
+//Outputs:
+//    The number of rows in a band, which is at least 1.
+int bandRows(int rows);
+
+//This function will shade the rows that belong to the given process in the
+//horizontal cycles scheme. When packed, the rows are written to the buffer
+//one after another, so it must have room for 3 * width * cycleLines()
+//floats. Otherwise the buffer is the image and the rows are written where
+//they belong in it.
+//
+//Inputs:
+//    data - the ConfigData that holds the scene information.
+//    rank - the process whose rows should be shaded.
+//    buffer - the buffer that receives the rows.
+//    pack - true to pack the rows, false to write them into the image.
+void shadeRowCycles(ConfigData* data, int rank, float* buffer, bool pack);
+
+//This function will shade the columns that belong to the given process in
+//the vertical cycles scheme. When packed, the buffer holds an image that is
+//made of only those columns, in row-major order, so it must have room for
+//3 * height * cycleLines() floats. Otherwise the columns are written where
+//they belong in the image.
+//
+//Inputs:
+//    data - the ConfigData that holds the scene information.
+//    rank - the process whose columns should be shaded.
+//    buffer - the buffer that receives the columns.
+//    pack - true to pack the columns, false to write them into the image.
+void shadeColumnCycles(ConfigData* data, int rank, float* buffer, bool pack);
+
+//The following functions build MPI datatypes that describe where the
+//pixels of a process go in the image, so that they can be received
+//straight into the image without an intermediate copy. Every type is
+//committed and must be released with MPI_Type_free().
+
+//This function will return a type for one column of height pixels in a
+//row-major image with stride pixels per row. The extent of the type is a
+//single pixel, so a count of n of these types describes n neighbouring
+//columns. Sending n of them from a row-major buffer sends it column by
+//column.
+MPI_Datatype columnType(int height, int stride);
+
+//This function will return a type for the given block of the image.
+MPI_Datatype blockType(ConfigData* data, Tile block);
+
+//This function will return a type for a list of tiles of dynamicBlockWidth
+//x dynamicBlockHeight pixels. It matches a buffer that holds the tiles one
+//after another, each one row by row, as renderWorkStealing() fills it.
+MPI_Datatype tilesType(ConfigData* data, const int* tiles, int count);
+
+//This function will return a type for the rows of the given process in the
+//horizontal cycles scheme. It matches the packed buffer of shadeRowCycles().
+MPI_Datatype rowCyclesType(ConfigData* data, int rank);
+
+//This function will return a type for the columns of the given process in
+//the vertical cycles scheme. It matches a packed buffer of
+//shadeColumnCycles() that is sent as cycleLines() columnType()s.
+MPI_Datatype columnCyclesType(ConfigData* data, int rank);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef __SCENE_H__
+#define __SCENE_H__
+
+//The scene is described by a configuration file and the model and material
+//files that it names, all of which initialize() reads from the current
+//directory. When every process does that at the same time, the shared
+//filesystem gets one request per process for every file. Instead, the
+//master reads the files once and broadcasts them to one process per node,
+//which writes them to a node-local directory (see -stage). Every process
+//then loads the scene from the copy on its own node.
+//
+//With -scene-cache, the master keeps the files that it reads in one cache
+//file, together with the size and modification time of every file. Later
+//runs map the cache read-only and send it on as it is, without opening or
+//scanning any of the scene files, as long as none of them have changed.
+
+//This function will stage the scene files on every node and point the
+//-c argument at the staged configuration file. If anything goes wrong, the
+//arguments are left alone and the scene is loaded from where it is. Every
+//process must call this after MPI has been initialized and before
+//initialize().
+//
+//Inputs:
+//    argc - the number of arguments that will be handed to initialize().
+//    argv - the arguments that will be handed to initialize().
+void stageScene(int argc, char** argv);
+
+//This function will remove the staged scene files once every process on
+//the node, including every thread, has loaded the scene. Every process
+//must call this.
+void unstageScene();
+
+#endif
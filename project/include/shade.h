@@ -0,0 +1,38 @@
+#ifndef __SHADE_H__
+#define __SHADE_H__
+
+#include "RayTrace.h"
+
+//The library only shades one pixel per call. The following functions shade
+//a run of pixels into a caller-provided buffer, so that every loop over
+//pixels goes through one place that a batched renderer can later replace.
+//The pixels are bit-identical to calling shadePixel() on each of them.
+//This is where a packet tracer would take over whole runs of primary rays
+//once the library provides one; see README.txt.
+
+//This function will shade a run of pixels in one row of the image.
+//
+//Inputs:
+//    out - the buffer that receives the 3 * width color values.
+//    row - the row of the image.
+//    firstColumn - the first column of the run.
+//    width - the number of pixels in the run.
+//    data - the ConfigData that holds the scene information.
+void shadeSpan(float* out, int row, int firstColumn, int width, ConfigData* data);
+
+//This function will shade a rectangle of the image.
+//
+//Inputs:
+//    out - the buffer that receives the rectangle. Pixel (row, column) of
+//        the image is written to out[3 * ((row - firstRow) * outStride +
+//        (column - firstColumn))].
+//    firstRow - the first row of the rectangle.
+//    firstColumn - the first column of the rectangle.
+//    width - the number of columns in the rectangle.
+//    height - the number of rows in the rectangle.
+//    outStride - the number of pixels between two rows in the buffer.
+//    data - the ConfigData that holds the scene information.
+void shadeTile(float* out, int firstRow, int firstColumn, int width, int height,
+    int outStride, ConfigData* data);
+
+#endif
@@ -5,7 +5,13 @@
 
 void slaveMain( ConfigData *data );
 
+void slaveStaticStripsHorizontal(ConfigData *data);
 void slaveStaticStripsVertical(ConfigData *data);
+void slaveStaticCyclesHorizontal(ConfigData *data);
+void slaveStaticCyclesVertical(ConfigData *data);
 void slaveStaticBlocks(ConfigData *data);
+void slaveDynamic(ConfigData *data);
+void slaveWorkStealing(ConfigData *data);
+void slaveStaticCost(ConfigData *data);
 
 #endif
@@ -0,0 +1,29 @@
+#ifndef __STEALING_H__
+#define __STEALING_H__
+
+#include <vector>
+
+#include "RayTrace.h"
+
+//This function will render tiles of dynamicBlockWidth x dynamicBlockHeight
+//pixels until every tile has been taken by some process. Every process
+//starts with a contiguous share of the tiles in the order of tileOrder().
+//Once its own share is done, it takes half of the remaining tiles of
+//another process. The ranges of tiles are kept in an MPI window so that
+//no process has to stop rendering to answer a request. Every process in
+//MPI_COMM_WORLD must call this.
+//
+//Inputs:
+//    data - the ConfigData that holds the scene information.
+//
+//Outputs:
+//    tiles - the indices of the tiles that were rendered, in the order
+//        they were rendered.
+//    tilePixels - the pixels of each of the rendered tiles, one tile after
+//        another.
+//    communicationTime - the time that was spent taking work from the
+//        other processes.
+void renderWorkStealing(ConfigData* data, std::vector<int>* tiles,
+    std::vector<float>* tilePixels, double* communicationTime);
+
+#endif
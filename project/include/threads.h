@@ -0,0 +1,50 @@
+#ifndef __THREADS_H__
+#define __THREADS_H__
+
+#include "RayTrace.h"
+
+//shadePixel() is NOT safe to call from several threads on the same scene.
+//The meshes keep the state of the last hit inside the scene objects, so
+//concurrent calls on box.xml produce different pixels than a sequential
+//render. Every thread in the pool therefore gets its own copy of the scene,
+//loaded by its own call to initialize(). The copies are loaded in parallel
+//and are only used by the thread that owns them.
+
+//This function will start the threads that help the calling thread shade
+//pixels. renderOptions.threads - 1 threads are started, each with its own
+//copy of the scene. Nothing is started when only one thread is requested.
+//
+//Inputs:
+//    data - the ConfigData that holds the scene information of the
+//        calling thread.
+//
+//Outputs:
+//    true if there was an error in the processing; otherwise, false
+bool startThreads(ConfigData* data);
+
+//This function will stop the threads and clean up their copies of
+//the scene. The threads can be started again afterwards.
+void stopThreads();
+
+//This function will shade a rectangular region of the image using the
+//calling thread and all of the threads in the pool. The rows of the region
+//are handed out to the threads one at a time, or with -order morton or
+//hilbert, small square cells of it in the order of the curve (see
+//regionCells()). It returns once every pixel of the region has been
+//shaded. Pixels that are in the checkpoint given with -resume are read
+//from it instead of being shaded (see checkpoint.h).
+//
+//Inputs:
+//    pixels - the buffer that receives the region. Pixel (row, column) of
+//        the image is written to pixels[3 * ((row - firstRow) * stride +
+//        (column - firstColumn))].
+//    firstRow - the first row of the image to shade.
+//    firstColumn - the first column of the image to shade.
+//    width - the number of columns to shade.
+//    height - the number of rows to shade.
+//    stride - the number of pixels between two rows in the buffer.
+//    data - the ConfigData that holds the scene information.
+void shadeRegion(float* pixels, int firstRow, int firstColumn, int width,
+    int height, int stride, ConfigData* data);
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef __TILES_H__
+#define __TILES_H__
+
+#include <vector>
+
+#include "RayTrace.h"
+
+//Message tags used between the master and the slaves when tiles are
+//handed out on demand.
+#define TAG_TILE_ASSIGN 100
+#define TAG_TILE_RESULT 101
+
+//Sent instead of a result by a slave that dropped a tile because another
+//slave returned it first.
+#define TAG_TILE_SKIPPED 102
+
+//A tile index that tells a slave there is no more work to be done.
+#define TILE_NONE -1
+
+//Turns a tile index into the index sent to tell a slave to drop the tile,
+//and back again. Cancels go out with TAG_TILE_ASSIGN so that they arrive
+//in order with the tiles and before TILE_NONE.
+#define TILE_CANCEL(index) (-(index) - 2)
+
+//The number of tiles that the master keeps outstanding for each slave.
+//While a slave shades one tile, the next one is already waiting in its
+//queue, so the slave never has to wait on a round trip to the master.
+#define TILES_IN_FLIGHT 2
+
+//With -order morton or hilbert, a region is shaded in square cells of this
+//many pixels on a side, which are taken in the order of the curve.
+#define CELL_SIZE 8
+
+//The orders that the tiles of the image, and the cells of a region that a
+//process shades, are worked through in.
+typedef enum
+{
+    //Row by row from the top left, which is how the image is laid out.
+    ORDER_ROWS = 0,
+    //Along a Z-order (Morton) curve, which visits the cells of every
+    //aligned square of 2^k x 2^k cells before leaving it.
+    ORDER_MORTON = 1,
+    //Along a Hilbert curve, which does the same and also only ever steps
+    //to a neighbouring cell.
+    ORDER_HILBERT = 2
+} TileOrder;
+
+//Describes a rectangular region of the image in pixels.
+typedef struct
+{
+    int row;
+    int column;
+    int width;
+    int height;
+} Tile;
+
+//This function will return the number of tiles that are needed to cover
+//the image when it is split into blocks of tileWidth x tileHeight pixels.
+//The tiles on the right and bottom edges may be smaller than the others.
+//
+//Inputs:
+//    data - the ConfigData that holds the image size.
+//    tileWidth - the width of a tile in pixels.
+//    tileHeight - the height of a tile in pixels.
+//
+//Outputs:
+//    The number of tiles.
+int tileCount(ConfigData *data, int tileWidth, int tileHeight);
+
+//This function will return the region covered by the given tile. Tiles
+//are numbered in row-major order starting at the top left of the image.
+//
+//Inputs:
+//    data - the ConfigData that holds the image size.
+//    tileWidth - the width of a tile in pixels.
+//    tileHeight - the height of a tile in pixels.
+//    index - the tile number, 0 <= index < tileCount().
+//
+//Outputs:
+//    The tile, clipped to the bounds of the image.
+Tile tileAt(ConfigData *data, int tileWidth, int tileHeight, int index);
+
+//This function will list the cells of a grid in the given order. The
+//curves are laid over the smallest power of two square that covers the
+//grid, and the cells outside the grid are left out.
+//
+//Inputs:
+//    columns - the number of columns of cells in the grid.
+//    rows - the number of rows of cells in the grid.
+//    order - the order to list the cells in.
+//
+//Outputs:
+//    The row-major numbers (row * columns + column) of all of the cells,
+//    in order.
+std::vector<int> curveOrder(int columns, int rows, TileOrder order);
+
+//This function will split a region into the pieces that it is shaded in,
+//in the given order: one row at a time for ORDER_ROWS, or cells of
+//CELL_SIZE x CELL_SIZE pixels along the curve. The cells on the right and
+//bottom edges may be smaller than the others.
+//
+//Inputs:
+//    width - the number of columns in the region.
+//    height - the number of rows in the region.
+//    order - the order to shade the region in.
+//
+//Outputs:
+//    The pieces, relative to the top left corner of the region, in order.
+std::vector<Tile> regionCells(int width, int height, TileOrder order);
+
+//This function will list the tiles of the image in the order that they
+//are handed out in, which is selected with -order. The tiles keep their
+//row-major numbers (see tileAt()); only the order that they are worked
+//through in changes.
+//
+//Inputs:
+//    data - the ConfigData that holds the image size.
+//    tileWidth - the width of a tile in pixels.
+//    tileHeight - the height of a tile in pixels.
+//
+//Outputs:
+//    The numbers of all of the tiles, in order.
+std::vector<int> tileOrder(ConfigData *data, int tileWidth, int tileHeight);
+
+#endif
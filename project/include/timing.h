@@ -0,0 +1,53 @@
+#ifndef __TIMING_H__
+#define __TIMING_H__
+
+#include "RayTrace.h"
+
+//The kinds of time that every process keeps track of while rendering.
+typedef enum
+{
+    //Time spent in shadeRegion(), including the threads of the pool.
+    TIME_SHADE = 0,
+    //Time spent sending, receiving and waiting for MPI messages, including
+    //converting pixels to and from the wire format.
+    TIME_WAIT = 1,
+    //Time spent copying pixels into the image and writing streamed rows.
+    TIME_COPY = 2,
+    //The whole time that the process spent rendering its share.
+    TIME_TOTAL = 3,
+    TIME_KINDS = 4
+} TimeKind;
+
+//Holds the timing of one process.
+typedef struct
+{
+    double seconds[TIME_KINDS];
+    //The number of pixels that the process shaded. Kept as a double so
+    //that the whole struct can be gathered as MPI_DOUBLEs.
+    double pixels;
+} RankTiming;
+
+//The timing of this process. It is filled in while rendering.
+extern RankTiming rankTiming;
+
+//This function will add time to one of the kinds of time of this process.
+//
+//Inputs:
+//    kind - the kind of time to add to.
+//    seconds - the time to add.
+inline void recordTime(TimeKind kind, double seconds)
+{
+    rankTiming.seconds[kind] += seconds;
+}
+
+//This function will gather the timing of every process on the master and
+//print the time of every process, the minimum, mean and maximum of each
+//kind of time and how unbalanced the processes were (maximum / mean). With
+//-report json or -report csv the same numbers are printed again in that
+//format. Every process must call this.
+//
+//Inputs:
+//    data - the ConfigData that holds the scene information.
+void reportTiming(ConfigData* data);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef __TONE_H__
+#define __TONE_H__
+
+#include "RayTrace.h"
+
+//With -tone, the image is tone mapped before it is saved. Both operators
+//need the log-average luminance of the whole image and Reinhard's also
+//needs the largest luminance, so every process adds up the luminance of
+//the pixels that it shades as it goes, and the sums are combined with
+//MPI_Allreduce once the image is shaded. Every process then maps its own
+//pixels before sending them, so the master never makes a pass over the
+//whole image and the pixels fit in 8 bits on the wire.
+//
+//The dynamic scheme sends every tile as soon as it is shaded, before the
+//luminance of the image is known, so there the sums are still combined
+//from every process but the master maps the image once it has all of it.
+
+//This function will return true if tone mapping was asked for with -tone.
+bool toneMapping();
+
+//This function will add the luminance of a region of the image to the sums
+//of this process. shadeRegion() calls this for every region it shades.
+//
+//Inputs:
+//    pixels - the region. Pixel (row, column) of the region is at
+//        pixels[3 * (row * stride + column)].
+//    width - the number of columns in the region.
+//    height - the number of rows in the region.
+//    stride - the number of pixels between two rows in the buffer.
+void measureLuminance(const float* pixels, int width, int height, int stride);
+
+//This function will drop the sums of this process, for when another
+//process measures the pixels that it shaded instead.
+void discardLuminance();
+
+//This function will combine the sums of every process and set up the
+//operator for the image. The sums start over for the next image. Every
+//process must call this once the image is shaded and before it maps any
+//pixels. It does nothing without -tone.
+//
+//Outputs:
+//    The time that was spent combining the sums, in seconds.
+double combineLuminance();
+
+//This function will tone map a region of the image in place. It does
+//nothing without -tone.
+//
+//Inputs:
+//    pixels - the region, laid out as for measureLuminance().
+//    width - the number of columns in the region.
+//    height - the number of rows in the region.
+//    stride - the number of pixels between two rows in the buffer.
+void toneMapRegion(float* pixels, int width, int height, int stride);
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef __WIRE_H__
+#define __WIRE_H__
+
+#include <vector>
+#include <mpi.h>
+
+#include "RayTrace.h"
+
+//The formats that pixels can be sent between processes in.
+typedef enum
+{
+    //32-bit floats; the pixels arrive exactly as they were shaded.
+    WIRE_FLOAT = 0,
+    //16-bit half floats; keeps high dynamic range at half the size.
+    WIRE_HALF = 1,
+    //8-bit values that are already converted the way savePixels() does,
+    //so the saved image is identical to sending floats.
+    WIRE_BYTE = 2
+} WireFormat;
+
+//This function will return the MPI type of one color channel in the wire
+//format that was selected with -wire.
+MPI_Datatype wireElement();
+
+//This function will convert color channels to the wire format.
+//
+//Inputs:
+//    pixels - the color channels to convert.
+//    wire - the buffer that receives count values in the wire format.
+//    count - the number of color channels.
+void encodePixels(const float* pixels, void* wire, int count);
+
+//This function will convert color channels from the wire format.
+//
+//Inputs:
+//    wire - count values in the wire format.
+//    pixels - the buffer that receives the color channels.
+//    count - the number of color channels.
+void decodePixels(const void* wire, float* pixels, int count);
+
+//The following functions move pixels between processes in the selected
+//wire format. The pixels are described by a count of an MPI datatype that
+//is made of MPI_FLOATs, just like a regular send or receive. When sending
+//floats, the pixels are sent and received straight from and into the
+//buffers. Otherwise they are converted through a contiguous buffer on
+//both ends, in the order that the datatype lists them.
+
+//Holds a send or a receive that is in progress.
+typedef struct
+{
+    MPI_Request request;
+    bool receiving;
+    float* pixels;
+    int count;
+    MPI_Datatype type;
+    std::vector<unsigned char> wire;
+} PixelTransfer;
+
+//This function will start sending pixels to another process.
+void startSendPixels(float* pixels, int count, MPI_Datatype type, int dest,
+    int tag, PixelTransfer* transfer);
+
+//This function will start receiving pixels from another process.
+void startReceivePixels(float* pixels, int count, MPI_Datatype type, int source,
+    int tag, PixelTransfer* transfer);
+
+//This function will wait for sends and receives to complete. Received
+//pixels are in place once this returns.
+//
+//Inputs:
+//    transfers - the transfers to wait for.
+//    count - the number of transfers.
+void finishPixels(PixelTransfer* transfers, int count);
+
+//This function will wait for any one of the transfers to complete, in
+//whatever order they do, like MPI_Waitany. Received pixels are in place
+//once this returns, and the transfer is not waited for again.
+//
+//Inputs:
+//    transfers - the transfers to wait for.
+//    count - the number of transfers.
+//
+//Outputs:
+//    The index of the transfer that completed, or MPI_UNDEFINED once none
+//    of them are in progress any more.
+int finishAnyPixels(PixelTransfer* transfers, int count);
+
+//This function will finish one of the transfers if any has completed,
+//without waiting, like MPI_Testany. Calling it also lets MPI move the
+//transfers along while the process is busy with something else.
+//
+//Outputs:
+//    The index of the transfer that completed, or MPI_UNDEFINED if none
+//    has.
+int testAnyPixels(PixelTransfer* transfers, int count);
+
+//This function will send pixels to another process and wait for the send
+//to complete.
+void sendPixels(float* pixels, int count, MPI_Datatype type, int dest, int tag);
+
+//This function will receive pixels from another process.
+void receivePixels(float* pixels, int count, MPI_Datatype type, int source, int tag);
+
+#endif
@@ -0,0 +1,331 @@
+//This file contains the code that renders several frames with the camera
+//moving between keyframes.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <mpi.h>
+#include <unistd.h>
+
+#include "RayTrace.h"
+#include "animation.h"
+#include "antialias.h"
+#include "image.h"
+#include "options.h"
+#include "threads.h"
+
+//The position of the camera at one keyframe.
+typedef struct
+{
+    int frame;
+    double eye[3];
+    double lookAt[3];
+} Keyframe;
+
+static std::vector<Keyframe> keyframes;
+
+//The configuration file, and the IDs of the points that the camera uses
+//for its eye point and the point it looks at.
+static std::string config;
+static std::string eyeID, lookAtID;
+
+//Where the camera of the scene that is loaded now is, so that a frame with
+//the camera in the same place does not load the scene again.
+static double loadedEye[3], loadedLookAt[3];
+
+//The name of the first frame without its extension, and the current frame.
+static std::string baseName;
+static int currentFrame = 0;
+
+//Encodes the previous frame while the next one renders.
+static std::thread writer;
+
+//Broadcasts a string from the master.
+static void broadcastString(std::string* value)
+{
+    int size = value->size();
+    MPI_Bcast(&size, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    value->resize(size);
+    MPI_Bcast(&(*value)[0], size, MPI_CHAR, 0, MPI_COMM_WORLD);
+}
+
+//Reads a whole file on the master and shares it with every process.
+//Returns false if the master could not read it.
+static bool shareFile(ConfigData* data, const char* path, std::string* contents)
+{
+    int found = 1;
+    if (data->mpi_rank == 0)
+    {
+        std::ifstream file(path);
+        std::ostringstream stream;
+        stream << file.rdbuf();
+        *contents = stream.str();
+        found = file ? 1 : 0;
+    }
+    MPI_Bcast(&found, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    broadcastString(contents);
+    return found;
+}
+
+//Returns the value of the given attribute of the first element that starts
+//with the given text, or an empty string.
+static std::string attribute(const std::string& xml, const std::string& element, const std::string& name)
+{
+    size_t start = xml.find(element);
+    size_t end = xml.find('>', start);
+    std::string pattern = " " + name + "=\"";
+    size_t at = xml.find(pattern, start);
+    if (start == std::string::npos || at == std::string::npos || at > end)
+    {
+        return "";
+    }
+    at += pattern.size();
+    return xml.substr(at, xml.find('"', at) - at);
+}
+
+//Returns the value of an argument that initialize() will see, or NULL.
+static const char* argument(const char* name)
+{
+    for (int i = 1; i + 1 < renderOptions.sceneArgc; i++)
+    {
+        if (strcmp(renderOptions.sceneArgv[i], name) == 0)
+        {
+            return renderOptions.sceneArgv[i + 1];
+        }
+    }
+    return NULL;
+}
+
+//Reads the coordinates of the point with the given ID.
+static void readPoint(const std::string& xml, const std::string& id, double* position)
+{
+    std::string element = "<Point ID=\"" + id + "\"";
+    position[0] = atof(attribute(xml, element, "X").c_str());
+    position[1] = atof(attribute(xml, element, "Y").c_str());
+    position[2] = atof(attribute(xml, element, "Z").c_str());
+}
+
+int startAnimation(ConfigData* data)
+{
+    if (renderOptions.framesFile == NULL)
+    {
+        return 1;
+    }
+
+    std::string text;
+    if (!shareFile(data, renderOptions.framesFile, &text))
+    {
+        std::cerr << "Could not read the keyframes in " << renderOptions.framesFile << std::endl;
+        return 0;
+    }
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        std::istringstream words(line);
+        Keyframe keyframe;
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        if (!(words >> keyframe.frame >> keyframe.eye[0] >> keyframe.eye[1] >> keyframe.eye[2] >>
+            keyframe.lookAt[0] >> keyframe.lookAt[1] >> keyframe.lookAt[2]) ||
+            (!keyframes.empty() && keyframe.frame <= keyframes.back().frame))
+        {
+            std::cerr << "Bad keyframe (the frames must go up): " << line << std::endl;
+            return 0;
+        }
+        keyframes.push_back(keyframe);
+    }
+    if (keyframes.empty())
+    {
+        std::cerr << "There are no keyframes in " << renderOptions.framesFile << std::endl;
+        return 0;
+    }
+
+    //Keep the configuration file so that a copy of it can be written with
+    //the camera moved for every frame.
+    const char* file = argument("-c");
+    if (file == NULL || !shareFile(data, file, &config))
+    {
+        std::cerr << "Could not read the configuration file for the camera." << std::endl;
+        return 0;
+    }
+    eyeID = attribute(config, "<Camera", "EyePoint");
+    lookAtID = attribute(config, "<Camera", "LookAt");
+    if (eyeID.empty() || lookAtID.empty())
+    {
+        std::cerr << "Could not find the camera in the configuration file." << std::endl;
+        return 0;
+    }
+
+    readPoint(config, eyeID, loadedEye);
+    readPoint(config, lookAtID, loadedLookAt);
+
+    if (data->mpi_rank == 0)
+    {
+        std::string name = "renders/" + generateFileName();
+        baseName = name.substr(0, name.find_last_of('.'));
+    }
+    return keyframes.back().frame - keyframes.front().frame + 1;
+}
+
+//Replaces the coordinates of the point with the given ID.
+static void movePoint(std::string* xml, const std::string& id, const double* position)
+{
+    size_t start = xml->find("<Point ID=\"" + id + "\"");
+    if (start == std::string::npos)
+    {
+        return;
+    }
+    size_t end = xml->find("/>", start) + 2;
+    std::ostringstream point;
+    point.precision(17);
+    point << "<Point ID=\"" << id << "\" X=\"" << position[0] << "\" Y=\"" << position[1];
+    point << "\" Z=\"" << position[2] << "\" />";
+    xml->replace(start, end - start, point.str());
+}
+
+//Loads every copy of the scene again from the given configuration file:
+//the one in data, the ones of the threads and the one for anti-aliasing.
+static bool reloadScene(ConfigData* data, const std::string& file)
+{
+    char* original = NULL;
+    for (int i = 1; i + 1 < renderOptions.sceneArgc; i++)
+    {
+        if (strcmp(renderOptions.sceneArgv[i], "-c") == 0)
+        {
+            original = renderOptions.sceneArgv[i + 1];
+            renderOptions.sceneArgv[i + 1] = (char*)file.c_str();
+        }
+    }
+
+    stopThreads();
+    stopAntialiasing();
+    int rank = data->mpi_rank, procs = data->mpi_procs;
+    shutdown(data);
+    std::vector<char*> args(renderOptions.sceneArgv, renderOptions.sceneArgv + renderOptions.sceneArgc + 1);
+    int argc = renderOptions.sceneArgc;
+    char** argv = &args[0];
+    bool failed = initialize(&argc, &argv, data);
+    data->mpi_rank = rank;
+    data->mpi_procs = procs;
+    applyRenderOptions(data);
+    failed = failed || startAntialiasing(data) || startThreads(data);
+
+    for (int i = 1; i + 1 < renderOptions.sceneArgc; i++)
+    {
+        if (renderOptions.sceneArgv[i + 1] == file.c_str())
+        {
+            renderOptions.sceneArgv[i + 1] = original;
+        }
+    }
+    return failed;
+}
+
+bool setFrame(ConfigData* data, int frame)
+{
+    currentFrame = frame;
+    if (keyframes.empty())
+    {
+        return false;
+    }
+
+    //Interpolate between the keyframes around the frame.
+    frame += keyframes.front().frame;
+    size_t next = 1;
+    while (next < keyframes.size() && keyframes[next].frame < frame)
+    {
+        next++;
+    }
+    Keyframe before = keyframes[next < keyframes.size() ? next - 1 : keyframes.size() - 1];
+    Keyframe after = keyframes[next < keyframes.size() ? next : keyframes.size() - 1];
+    double t = after.frame == before.frame ? 0.0 : (double)(frame - before.frame) / (after.frame - before.frame);
+    double eye[3], lookAt[3];
+    for (int i = 0; i < 3; i++)
+    {
+        eye[i] = before.eye[i] + t * (after.eye[i] - before.eye[i]);
+        lookAt[i] = before.lookAt[i] + t * (after.lookAt[i] - before.lookAt[i]);
+    }
+
+    //The first frame usually has the camera where the configuration file
+    //puts it, and the scene is already loaded that way.
+    if (std::equal(eye, eye + 3, loadedEye) && std::equal(lookAt, lookAt + 3, loadedLookAt))
+    {
+        return false;
+    }
+    std::copy(eye, eye + 3, loadedEye);
+    std::copy(lookAt, lookAt + 3, loadedLookAt);
+
+    std::string xml = config;
+    movePoint(&xml, eyeID, eye);
+    movePoint(&xml, lookAtID, lookAt);
+    std::ostringstream name;
+    name << (renderOptions.stageDirectory ? renderOptions.stageDirectory : "/tmp");
+    name << "/raytrace-frame-" << getpid() << ".xml";
+    std::string file = name.str();
+    std::ofstream stream(file.c_str());
+    stream << xml;
+    stream.close();
+    if (!stream)
+    {
+        std::cerr << "Could not write the camera for frame " << currentFrame << " to " << file << std::endl;
+        return true;
+    }
+
+    bool failed = reloadScene(data, file);
+    unlink(file.c_str());
+    return failed;
+}
+
+std::string frameFileName()
+{
+    if (keyframes.empty())
+    {
+        return "renders/" + generateFileName();
+    }
+    char frame[16];
+    snprintf(frame, sizeof(frame), "-%04d", currentFrame);
+    return baseName + frame + ".png";
+}
+
+void saveFrame(std::string file, float* pixels, ConfigData* data)
+{
+    if (keyframes.empty())
+    {
+        savePixels(file, pixels, data);
+        delete[] pixels;
+        return;
+    }
+
+    //Only one frame is written at a time.
+    if (writer.joinable())
+    {
+        writer.join();
+    }
+    ConfigData size = *data;
+    writer = std::thread([file, pixels, size]() mutable {
+        ImageWriter* image = openImage(file, &size);
+        if (image != NULL)
+        {
+            writeRows(image, pixels, size.height);
+            closeImage(image);
+        }
+        delete[] pixels;
+    });
+}
+
+void finishAnimation()
+{
+    if (writer.joinable())
+    {
+        writer.join();
+    }
+}
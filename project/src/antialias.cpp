@@ -0,0 +1,192 @@
+//This file contains the adaptive anti-aliasing pass.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <mpi.h>
+
+#include "RayTrace.h"
+#include "antialias.h"
+#include "options.h"
+#include "timing.h"
+#include "tone.h"
+
+//The scene at k times the size of the image.
+static ConfigData samples;
+static bool loaded = false;
+
+bool startAntialiasing(ConfigData* data)
+{
+    int k = renderOptions.antialiasing;
+    if (k < 2)
+    {
+        return false;
+    }
+
+    //Load the same scene with the width and height scaled up.
+    std::ostringstream width, height;
+    width << k * data->width;
+    height << k * data->height;
+    std::string scaledWidth = width.str(), scaledHeight = height.str();
+    std::vector<char*> args(renderOptions.sceneArgv, renderOptions.sceneArgv + renderOptions.sceneArgc + 1);
+    for (int i = 1; i + 1 < renderOptions.sceneArgc; i++)
+    {
+        if (strcmp(args[i], "-w") == 0)
+        {
+            args[i + 1] = (char*)scaledWidth.c_str();
+        }
+        else if (strcmp(args[i], "-h") == 0)
+        {
+            args[i + 1] = (char*)scaledHeight.c_str();
+        }
+    }
+
+    int argc = renderOptions.sceneArgc;
+    char** argv = &args[0];
+    if (initialize(&argc, &argv, &samples))
+    {
+        return true;
+    }
+    samples.mpi_rank = data->mpi_rank;
+    samples.mpi_procs = data->mpi_procs;
+    loaded = true;
+    return false;
+}
+
+void stopAntialiasing()
+{
+    if (loaded)
+    {
+        shutdown(&samples);
+        loaded = false;
+    }
+}
+
+//Returns the brightness of a pixel as it will be saved.
+static float brightness(const float* color)
+{
+    return 0.2126f * std::min(1.0f, color[0]) + 0.7152f * std::min(1.0f, color[1]) +
+        0.0722f * std::min(1.0f, color[2]);
+}
+
+//Returns the pixels of the image that sit on an edge, as row * width + column.
+static std::vector<int> findEdges(ConfigData* data, float* pixels)
+{
+    std::vector<int> edges;
+    for (int row = 0; row < data->height; row++)
+    {
+        for (int column = 0; column < data->width; column++)
+        {
+            int index = row * data->width + column;
+            float center = brightness(&pixels[3 * index]);
+            float contrast = 0.0f;
+            if (row > 0)
+            {
+                contrast = std::max(contrast, std::abs(center - brightness(&pixels[3 * (index - data->width)])));
+            }
+            if (row + 1 < data->height)
+            {
+                contrast = std::max(contrast, std::abs(center - brightness(&pixels[3 * (index + data->width)])));
+            }
+            if (column > 0)
+            {
+                contrast = std::max(contrast, std::abs(center - brightness(&pixels[3 * (index - 1)])));
+            }
+            if (column + 1 < data->width)
+            {
+                contrast = std::max(contrast, std::abs(center - brightness(&pixels[3 * (index + 1)])));
+            }
+            if (contrast > renderOptions.antialiasingThreshold)
+            {
+                edges.push_back(index);
+            }
+        }
+    }
+    return edges;
+}
+
+void refineEdges(ConfigData* data, float* pixels)
+{
+    if (!loaded)
+    {
+        return;
+    }
+    double start = MPI_Wtime();
+    int k = renderOptions.antialiasing;
+
+    //Tell everyone which pixels need more samples.
+    double communicationStart = MPI_Wtime();
+    std::vector<int> edges;
+    if (data->mpi_rank == 0)
+    {
+        edges = findEdges(data, pixels);
+    }
+    int count = edges.size();
+    MPI_Bcast(&count, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    edges.resize(count);
+    MPI_Bcast(edges.empty() ? NULL : &edges[0], count, MPI_INT, 0, MPI_COMM_WORLD);
+    recordTime(TIME_WAIT, MPI_Wtime() - communicationStart);
+
+    //The edges are dealt out in turn, since they bunch up around objects.
+    double shadeStart = MPI_Wtime();
+    std::vector<float> refined;
+    for (int i = data->mpi_rank; i < count; i += data->mpi_procs)
+    {
+        int row = edges[i] / data->width;
+        int column = edges[i] % data->width;
+        float sum[3] = { 0.0f, 0.0f, 0.0f };
+        for (int sampleRow = k * row; sampleRow < k * (row + 1); sampleRow++)
+        {
+            for (int sampleColumn = k * column; sampleColumn < k * (column + 1); sampleColumn++)
+            {
+                float color[3];
+                shadePixel(color, sampleRow, sampleColumn, &samples);
+                toneMapRegion(color, 1, 1, 1);
+                sum[0] += color[0];
+                sum[1] += color[1];
+                sum[2] += color[2];
+            }
+        }
+        for (int channel = 0; channel < 3; channel++)
+        {
+            refined.push_back(sum[channel] / (k * k));
+        }
+    }
+    recordTime(TIME_SHADE, MPI_Wtime() - shadeStart);
+
+    //Collect the averages on the master, every process's share in turn.
+    communicationStart = MPI_Wtime();
+    std::vector<int> counts(data->mpi_procs), displacements(data->mpi_procs, 0);
+    for (int i = 0; i < data->mpi_procs; i++)
+    {
+        counts[i] = 3 * (i < count ? (count - i + data->mpi_procs - 1) / data->mpi_procs : 0);
+        if (i > 0)
+        {
+            displacements[i] = displacements[i - 1] + counts[i - 1];
+        }
+    }
+    std::vector<float> all(data->mpi_rank == 0 ? 3 * count : 0);
+    MPI_Gatherv(refined.empty() ? NULL : &refined[0], refined.size(), MPI_FLOAT,
+        all.empty() ? NULL : &all[0], &counts[0], &displacements[0], MPI_FLOAT, 0, MPI_COMM_WORLD);
+    recordTime(TIME_WAIT, MPI_Wtime() - communicationStart);
+
+    if (data->mpi_rank != 0)
+    {
+        return;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        int rank = i % data->mpi_procs;
+        int offset = displacements[rank] + 3 * (i / data->mpi_procs);
+        memcpy(&pixels[3 * edges[i]], &all[offset], 3 * sizeof(float));
+    }
+
+    std::cout << "Adaptive Anti-Aliasing: refined " << count << " of " << data->width * data->height;
+    std::cout << " pixels with " << k << "x" << k << " samples in " << MPI_Wtime() - start;
+    std::cout << " seconds" << std::endl;
+}
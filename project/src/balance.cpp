@@ -0,0 +1,151 @@
+//This file contains the code that splits the image into blocks of equal
+//estimated cost for the static cost partitioning scheme.
+
+#include <algorithm>
+#include <vector>
+#include <mpi.h>
+
+#include "RayTrace.h"
+#include "balance.h"
+#include "checkpoint.h"
+#include "options.h"
+#include "timing.h"
+
+//The estimated cost of the image, one value per cell of step x step pixels.
+typedef struct
+{
+    int step;
+    int rows;
+    int columns;
+    //The estimated time to shade one pixel of each cell, row-major.
+    std::vector<double> cells;
+} CostGrid;
+
+//Returns the number of lines of first <= line < first + count that fall in
+//the given cell.
+static int overlap(int first, int count, int cell, int step)
+{
+    int start = std::max(first, cell * step);
+    int end = std::min(first + count, (cell + 1) * step);
+    return std::max(0, end - start);
+}
+
+//Returns the estimated cost of every column of the block (or every row,
+//when columns is false), added up over the other direction.
+static std::vector<double> lineCosts(const CostGrid& grid, Tile block, bool columns)
+{
+    int first = columns ? block.column : block.row;
+    int lines = columns ? block.width : block.height;
+    int across = columns ? block.row : block.column;
+    int acrossLines = columns ? block.height : block.width;
+
+    std::vector<double> costs(lines, 0.0);
+    for (int line = 0; line < lines; line++)
+    {
+        int cell = (first + line) / grid.step;
+        for (int other = across / grid.step; other * grid.step < across + acrossLines; other++)
+        {
+            int index = columns ? other * grid.columns + cell : cell * grid.columns + other;
+            costs[line] += grid.cells[index] * overlap(across, acrossLines, other, grid.step);
+        }
+    }
+    return costs;
+}
+
+//Splits the block between the processes first <= rank < last.
+static void bisect(const CostGrid& grid, Tile block, int first, int last,
+    std::vector<Tile>* blocks, std::vector<double>* predicted)
+{
+    bool columns = block.width >= block.height;
+    std::vector<double> costs = lineCosts(grid, block, columns);
+    double total = 0.0;
+    for (size_t i = 0; i < costs.size(); i++)
+    {
+        total += costs[i];
+    }
+
+    if (last - first == 1)
+    {
+        (*blocks)[first] = block;
+        (*predicted)[first] = total;
+        return;
+    }
+
+    //Give the first half of the processes the lines whose cost adds up
+    //closest to their share of the total.
+    int middle = (first + last) / 2;
+    double target = total * (middle - first) / (last - first);
+    int lines = costs.size();
+    int split = 0;
+    double sum = 0.0;
+    while (split < lines && sum + costs[split] / 2 < target)
+    {
+        sum += costs[split++];
+    }
+
+    //Keep at least one line on both sides whenever there are two lines.
+    if (lines >= 2)
+    {
+        split = std::max(1, std::min(lines - 1, split));
+    }
+
+    Tile low = block, high = block;
+    if (columns)
+    {
+        low.width = split;
+        high.column += split;
+        high.width -= split;
+    }
+    else
+    {
+        low.height = split;
+        high.row += split;
+        high.height -= split;
+    }
+    bisect(grid, low, first, middle, blocks, predicted);
+    bisect(grid, high, middle, last, blocks, predicted);
+}
+
+void balancedBlocks(ConfigData* data, std::vector<Tile>* blocks, std::vector<double>* predicted)
+{
+    CostGrid grid;
+    grid.step = renderOptions.sampleStep;
+    grid.rows = (data->height + grid.step - 1) / grid.step;
+    grid.columns = (data->width + grid.step - 1) / grid.step;
+    grid.cells.resize(grid.rows * grid.columns, 0.0);
+
+    //Time one pixel from the middle of every cell, with the cells dealt out
+    //to the processes in turn.
+    double shadeStart = MPI_Wtime();
+    float color[3];
+    for (int cell = data->mpi_rank; cell < grid.rows * grid.columns; cell += data->mpi_procs)
+    {
+        int row = std::min(data->height - 1, (cell / grid.columns) * grid.step + grid.step / 2);
+        int column = std::min(data->width - 1, (cell % grid.columns) * grid.step + grid.step / 2);
+        //The pixels that are in the checkpoint are not shaded again.
+        if (pixelRestored(row, column))
+        {
+            continue;
+        }
+        double start = MPI_Wtime();
+        shadePixel(color, row, column, data);
+        grid.cells[cell] = MPI_Wtime() - start;
+    }
+    recordTime(TIME_SHADE, MPI_Wtime() - shadeStart);
+
+    //Every cell was timed by exactly one process.
+    double communicationStart = MPI_Wtime();
+    MPI_Allreduce(MPI_IN_PLACE, &grid.cells[0], grid.cells.size(), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    recordTime(TIME_WAIT, MPI_Wtime() - communicationStart);
+
+    //The threads of a process share its block.
+    for (size_t i = 0; i < grid.cells.size(); i++)
+    {
+        grid.cells[i] /= renderOptions.threads;
+    }
+
+    Tile image = { 0, 0, data->width, data->height };
+    blocks->resize(data->mpi_procs);
+    predicted->resize(data->mpi_procs);
+    bisect(grid, image, 0, data->mpi_procs, blocks, predicted);
+}
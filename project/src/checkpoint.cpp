@@ -0,0 +1,391 @@
+//This file contains the code that saves the pixels of a render as they are
+//shaded and takes them back when a render is resumed.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <mpi.h>
+#include <unistd.h>
+
+#include "RayTrace.h"
+#include "checkpoint.h"
+#include "options.h"
+
+#define CHECKPOINT_MAGIC "RTCKPT01"
+
+//How often the pixels are written when only -resume was given.
+#define DEFAULT_SECONDS 60.0f
+
+//The writer is woken up early once this many bytes of pixels are waiting,
+//so that a fast render does not pile them up in memory.
+#define MAX_PENDING_BYTES (64 << 20)
+
+//The number of pixels along the diagonal of the image that are shaded to
+//tell whether a checkpoint was made of the same scene and camera.
+#define PROBES 8
+
+//The start of a checkpoint file.
+typedef struct
+{
+    char magic[8];
+    int width;
+    int height;
+    float probes[PROBES][3];
+} CheckpointHeader;
+
+//A run of shaded pixels in one row that is waiting to be written.
+typedef struct
+{
+    int row;
+    int column;
+    std::vector<float> pixels;
+} PendingRun;
+
+//The open checkpoint, or -1 without one, and the size of the image.
+static int file = -1;
+static std::string path;
+static int imageWidth, imageHeight;
+
+//True if the file may hold pixels from an earlier run.
+static bool resuming = false;
+
+//The thread that writes the pixels and the runs that it has not written.
+static std::thread writer;
+static std::mutex mutex;
+static std::condition_variable wake;
+static std::vector<PendingRun> pending;
+static size_t pendingBytes = 0;
+static bool stopping = false;
+static bool failed = false;
+
+//Returns where the map entry of a pixel is in the file.
+static off_t mapOffset(int row, int column)
+{
+    return sizeof(CheckpointHeader) + (off_t)row * imageWidth + column;
+}
+
+//Returns where the color of a pixel is in the file.
+static off_t pixelOffset(int row, int column)
+{
+    return sizeof(CheckpointHeader) + (off_t)imageWidth * imageHeight +
+        3 * sizeof(float) * ((off_t)row * imageWidth + column);
+}
+
+//Reads or writes all of the bytes, going around short reads and writes.
+//Returns false if the file ended or there was an error.
+static bool readAll(int fd, void* buffer, size_t size, off_t offset)
+{
+    char* bytes = (char*)buffer;
+    while (size > 0)
+    {
+        ssize_t done = pread(fd, bytes, size, offset);
+        if (done <= 0)
+        {
+            return false;
+        }
+        bytes += done;
+        offset += done;
+        size -= done;
+    }
+    return true;
+}
+
+static bool writeAll(int fd, const void* buffer, size_t size, off_t offset)
+{
+    const char* bytes = (const char*)buffer;
+    while (size > 0)
+    {
+        ssize_t done = pwrite(fd, bytes, size, offset);
+        if (done <= 0)
+        {
+            return false;
+        }
+        bytes += done;
+        offset += done;
+        size -= done;
+    }
+    return true;
+}
+
+//Fills in the header that a checkpoint of the image has. The library does
+//not name the scene, so a few pixels are shaded to tell it apart instead.
+static CheckpointHeader makeHeader(ConfigData* data)
+{
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.width = data->width;
+    header.height = data->height;
+    for (int i = 0; i < PROBES; i++)
+    {
+        shadePixel(header.probes[i], (2 * i + 1) * data->height / (2 * PROBES),
+            (2 * i + 1) * data->width / (2 * PROBES), data);
+    }
+    return header;
+}
+
+//Creates an empty checkpoint next to the image on the master. The file is
+//sparse until the pixels are written, so it costs nothing up front.
+static bool createFile(ConfigData* data)
+{
+    std::string name = "renders/" + generateFileName();
+    path = name.substr(0, name.find_last_of('.')) + ".ckpt";
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    CheckpointHeader header = makeHeader(data);
+    bool created = fd >= 0 && writeAll(fd, &header, sizeof(header), 0) &&
+        ftruncate(fd, pixelOffset(imageHeight, 0)) == 0;
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    if (!created)
+    {
+        std::cerr << "Could not create the checkpoint " << path << std::endl;
+        return false;
+    }
+    std::cout << "Checkpoint: " << path << " every " << renderOptions.checkpointSeconds;
+    std::cout << " seconds" << std::endl;
+    return true;
+}
+
+//Checks on the master that the checkpoint to resume from was made for the
+//same image, and tells how much of it is already done.
+static bool checkFile(ConfigData* data)
+{
+    path = renderOptions.resumeFile;
+    int fd = open(path.c_str(), O_RDONLY);
+    CheckpointHeader header, expected = makeHeader(data);
+    if (fd < 0 || !readAll(fd, &header, sizeof(header), 0) ||
+        memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0)
+    {
+        std::cerr << "Could not read the checkpoint " << path << std::endl;
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return false;
+    }
+    if (header.width != expected.width || header.height != expected.height)
+    {
+        std::cerr << "The checkpoint " << path << " is of a " << header.width << " x ";
+        std::cerr << header.height << " image, not of this render." << std::endl;
+        close(fd);
+        return false;
+    }
+    if (memcmp(header.probes, expected.probes, sizeof(header.probes)) != 0)
+    {
+        std::cerr << "The checkpoint " << path << " is of another scene or camera." << std::endl;
+        close(fd);
+        return false;
+    }
+
+    //Count the finished pixels one piece of the map at a time.
+    long long finished = 0;
+    long long total = (long long)imageWidth * imageHeight;
+    std::vector<unsigned char> map(1 << 20);
+    for (long long done = 0; done < total; done += map.size())
+    {
+        size_t size = std::min((long long)map.size(), total - done);
+        if (!readAll(fd, &map[0], size, mapOffset(0, 0) + done))
+        {
+            std::cerr << "The checkpoint " << path << " is cut short." << std::endl;
+            close(fd);
+            return false;
+        }
+        finished += std::count(map.begin(), map.begin() + size, 1);
+    }
+    close(fd);
+    std::cout << "Resuming from " << path << ": " << finished << " of " << total;
+    std::cout << " pixels are already shaded" << std::endl;
+    return true;
+}
+
+//Writes a batch of runs. The pixels reach the disk before they are marked
+//as finished in the map.
+static void writeRuns(const std::vector<PendingRun>& runs)
+{
+    if (runs.empty() || failed)
+    {
+        return;
+    }
+    bool written = true;
+    for (size_t i = 0; i < runs.size() && written; i++)
+    {
+        written = writeAll(file, &runs[i].pixels[0], runs[i].pixels.size() * sizeof(float),
+            pixelOffset(runs[i].row, runs[i].column));
+    }
+    written = written && fdatasync(file) == 0;
+
+    std::vector<unsigned char> marks;
+    for (size_t i = 0; i < runs.size() && written; i++)
+    {
+        marks.assign(runs[i].pixels.size() / 3, 1);
+        written = writeAll(file, &marks[0], marks.size(), mapOffset(runs[i].row, runs[i].column));
+    }
+    if (!written)
+    {
+        //Keep rendering; the image is still saved at the end.
+        std::cerr << "Could not write to the checkpoint " << path << "; no longer checkpointing." << std::endl;
+        failed = true;
+    }
+}
+
+//Writes the waiting runs every few seconds, or sooner when a lot of them
+//pile up, until the checkpoint is finished.
+static void writerMain()
+{
+    std::chrono::duration<double> interval(renderOptions.checkpointSeconds);
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wake.wait_for(lock, interval, [] { return stopping || pendingBytes >= MAX_PENDING_BYTES; });
+        std::vector<PendingRun> runs;
+        runs.swap(pending);
+        pendingBytes = 0;
+        bool last = stopping;
+        lock.unlock();
+
+        writeRuns(runs);
+
+        lock.lock();
+        if (last)
+        {
+            return;
+        }
+    }
+}
+
+bool startCheckpoint(ConfigData* data)
+{
+    if (renderOptions.checkpointSeconds <= 0.0f && renderOptions.resumeFile == NULL)
+    {
+        return false;
+    }
+    if (renderOptions.checkpointSeconds <= 0.0f)
+    {
+        renderOptions.checkpointSeconds = DEFAULT_SECONDS;
+    }
+    imageWidth = data->width;
+    imageHeight = data->height;
+    resuming = renderOptions.resumeFile != NULL;
+
+    //The master makes or checks the file, and tells everyone where it is.
+    int ready = 1;
+    if (data->mpi_rank == 0)
+    {
+        ready = (resuming ? checkFile(data) : createFile(data)) ? 1 : 0;
+    }
+    MPI_Bcast(&ready, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (!ready)
+    {
+        return true;
+    }
+    int size = path.size();
+    MPI_Bcast(&size, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    path.resize(size);
+    MPI_Bcast(&path[0], size, MPI_CHAR, 0, MPI_COMM_WORLD);
+
+    file = open(path.c_str(), O_RDWR);
+    if (file < 0)
+    {
+        std::cerr << "Process " << data->mpi_rank << " could not open the checkpoint " << path << std::endl;
+        return true;
+    }
+    writer = std::thread(writerMain);
+    return false;
+}
+
+void finishCheckpoint(ConfigData* data)
+{
+    if (file < 0)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+    close(file);
+    file = -1;
+
+    //The image has been saved, so the checkpoint is not needed any more.
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (data->mpi_rank == 0)
+    {
+        unlink(path.c_str());
+    }
+}
+
+void checkpointPixels(const float* pixels, int row, int firstColumn, int width)
+{
+    if (file < 0 || width <= 0)
+    {
+        return;
+    }
+    PendingRun run;
+    run.row = row;
+    run.column = firstColumn;
+    run.pixels.assign(pixels, pixels + 3 * width);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pendingBytes += run.pixels.size() * sizeof(float);
+    pending.push_back(run);
+    if (pendingBytes >= MAX_PENDING_BYTES)
+    {
+        wake.notify_one();
+    }
+}
+
+void restorePixels(float* out, int row, int firstColumn, int width, unsigned char* finished)
+{
+    memset(finished, 0, width);
+    if (file < 0 || !resuming)
+    {
+        return;
+    }
+    if (!readAll(file, finished, width, mapOffset(row, firstColumn)))
+    {
+        memset(finished, 0, width);
+        return;
+    }
+
+    //Read every run of finished pixels with one call.
+    for (int start = 0; start < width; )
+    {
+        if (!finished[start])
+        {
+            start++;
+            continue;
+        }
+        int end = start;
+        while (end < width && finished[end])
+        {
+            end++;
+        }
+        if (!readAll(file, &(out[3 * start]), 3 * sizeof(float) * (end - start),
+            pixelOffset(row, firstColumn + start)))
+        {
+            memset(&(finished[start]), 0, end - start);
+        }
+        start = end;
+    }
+}
+
+bool pixelRestored(int row, int column)
+{
+    unsigned char finished = 0;
+    if (file >= 0 && resuming)
+    {
+        readAll(file, &finished, 1, mapOffset(row, column));
+    }
+    return finished == 1;
+}
@@ -0,0 +1,129 @@
+//This file contains the code that saves the cost of every pixel.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <mpi.h>
+
+#include "RayTrace.h"
+#include "heatmap.h"
+#include "image.h"
+#include "options.h"
+
+float* costMap = NULL;
+bool costPerPixel = false;
+
+//Used to turn ticks into seconds at the end of the render.
+static unsigned long long startTicks;
+static double startSeconds;
+
+void startHeatmap(ConfigData* data)
+{
+    if (renderOptions.heatmapMode == NULL)
+    {
+        return;
+    }
+    costMap = new float[data->width * data->height];
+    memset(costMap, 0, sizeof(float) * data->width * data->height);
+    costPerPixel = strcmp(renderOptions.heatmapMode, "pixel") == 0;
+    startSeconds = MPI_Wtime();
+    startTicks = readTicks();
+}
+
+void discardCost(ConfigData* data, Tile region)
+{
+    if (costMap == NULL)
+    {
+        return;
+    }
+    for (int row = region.row; row < region.row + region.height; row++)
+    {
+        std::fill(&costMap[row * data->width + region.column],
+            &costMap[row * data->width + region.column + region.width], 0.0f);
+    }
+}
+
+//Maps a cost between 0 and 1 to a color.
+static void heatColor(float cost, float* color)
+{
+    color[0] = std::min(1.0f, 3.0f * cost);
+    color[1] = std::min(1.0f, std::max(0.0f, 3.0f * cost - 1.0f));
+    color[2] = std::min(1.0f, std::max(0.0f, 3.0f * cost - 2.0f));
+}
+
+void finishHeatmap(ConfigData* data, std::string file)
+{
+    if (costMap == NULL)
+    {
+        return;
+    }
+    double seconds = MPI_Wtime() - startSeconds;
+    unsigned long long ticks = readTicks() - startTicks;
+    int pixels = data->width * data->height;
+
+    //Only one process keeps the cost of every pixel: when the dynamic scheme
+    //has a tile shaded again, the slaves whose copies were thrown away take
+    //their cost back out (see discardCost()). So the sum is the cost.
+    if (data->mpi_rank == 0)
+    {
+        MPI_Reduce(MPI_IN_PLACE, costMap, pixels, MPI_FLOAT, MPI_SUM, 0, MPI_COMM_WORLD);
+    }
+    else
+    {
+        MPI_Reduce(costMap, NULL, pixels, MPI_FLOAT, MPI_SUM, 0, MPI_COMM_WORLD);
+    }
+
+    if (data->mpi_rank == 0)
+    {
+        double microsecondsPerTick = ticks > 0 ? 1.0e6 * seconds / ticks : 0.0;
+        //Scale the colors to the 99th percentile so that a few slow pixels
+        //(such as the first pixel of every tile) do not wash out the rest.
+        std::vector<float> sorted(costMap, costMap + pixels);
+        std::nth_element(sorted.begin(), sorted.begin() + pixels * 99 / 100, sorted.end());
+        float maxCost = sorted[pixels * 99 / 100];
+        std::string base = file.substr(0, file.find_last_of('.')) + "-cost";
+        std::cout << "Heatmap will be saved to: " << base << ".png and " << base << ".csv" << std::endl;
+
+        //Draw the image relative to the most expensive pixel.
+        ImageWriter* image = openImage(base + ".png", data);
+        FILE* csv = fopen((base + ".csv").c_str(), "w");
+        if (csv == NULL)
+        {
+            std::cerr << "There was an error opening the file at: " << base << ".csv" << std::endl;
+        }
+        std::vector<float> row(3 * data->width);
+        for (int i = 0; i < data->height; i++)
+        {
+            for (int j = 0; j < data->width; j++)
+            {
+                float cost = costMap[i * data->width + j];
+                heatColor(maxCost > 0.0f ? std::min(1.0f, cost / maxCost) : 0.0f, &row[3 * j]);
+                if (csv != NULL)
+                {
+                    fprintf(csv, j ? ",%.3f" : "%.3f", cost * microsecondsPerTick);
+                }
+            }
+            if (csv != NULL)
+            {
+                fprintf(csv, "\n");
+            }
+            if (image != NULL)
+            {
+                writeRows(image, &row[0], 1);
+            }
+        }
+        if (image != NULL)
+        {
+            closeImage(image);
+        }
+        if (csv != NULL)
+        {
+            fclose(csv);
+        }
+    }
+
+    delete[] costMap;
+    costMap = NULL;
+}
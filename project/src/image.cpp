@@ -0,0 +1,117 @@
+//This file contains the code that writes images to disk one row at a time.
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include <png.h>
+
+#include "RayTrace.h"
+#include "image.h"
+
+//The number of rows between two flushes of the compressed PNG data.
+#define FLUSH_ROWS 64
+
+struct ImageWriter
+{
+    FILE* file;
+    int width;
+
+    //Only used when writing a PNG file.
+    png_structp png;
+    png_infop info;
+
+    //Space for one row of 8-bit values.
+    std::vector<unsigned char> row;
+};
+
+ImageWriter* openImage(std::string filename, ConfigData* data)
+{
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (file == NULL)
+    {
+        std::cerr << "There was an error opening the file at: " << filename << std::endl;
+        return NULL;
+    }
+
+    ImageWriter* image = new ImageWriter;
+    image->file = file;
+    image->width = data->width;
+    image->png = NULL;
+    image->info = NULL;
+    image->row.resize(3 * data->width);
+
+    size_t dot = filename.find_last_of('.');
+    if (dot != std::string::npos && filename.substr(dot) == ".ppm")
+    {
+        fprintf(file, "P6\n%d %d\n255\n", data->width, data->height);
+        fflush(file);
+        return image;
+    }
+
+    image->png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    image->info = image->png ? png_create_info_struct(image->png) : NULL;
+    if (image->info == NULL || setjmp(png_jmpbuf(image->png)))
+    {
+        std::cerr << "There was an error creating the PNG file at: " << filename << std::endl;
+        png_destroy_write_struct(&image->png, &image->info);
+        fclose(file);
+        delete image;
+        return NULL;
+    }
+    png_init_io(image->png, file);
+    png_set_IHDR(image->png, image->info, data->width, data->height, 8, PNG_COLOR_TYPE_RGB,
+        PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(image->png, image->info);
+
+    //Flushing compresses worse, so only push out complete bands of rows.
+    png_set_flush(image->png, FLUSH_ROWS);
+    return image;
+}
+
+void writeRows(ImageWriter* image, float* pixels, int rows)
+{
+    if (image->png != NULL && setjmp(png_jmpbuf(image->png)))
+    {
+        std::cerr << "There was an error writing the PNG file." << std::endl;
+        return;
+    }
+
+    for (int row = 0; row < rows; row++)
+    {
+        for (int i = 0; i < 3 * image->width; i++)
+        {
+            image->row[i] = channelToByte(pixels[i]);
+        }
+        pixels += 3 * image->width;
+
+        if (image->png != NULL)
+        {
+            png_write_row(image->png, &image->row[0]);
+        }
+        else
+        {
+            fwrite(&image->row[0], 1, image->row.size(), image->file);
+        }
+    }
+
+    //Push the rows to disk so that they survive if the render is stopped.
+    fflush(image->file);
+}
+
+void closeImage(ImageWriter* image)
+{
+    if (image->png != NULL && setjmp(png_jmpbuf(image->png)))
+    {
+        std::cerr << "There was an error finishing the PNG file." << std::endl;
+    }
+    else if (image->png != NULL)
+    {
+        png_write_end(image->png, NULL);
+    }
+    if (image->png != NULL)
+    {
+        png_destroy_write_struct(&image->png, &image->info);
+    }
+    fclose(image->file);
+    delete image;
+}
@@ -11,26 +11,69 @@
 using namespace std;
 
 #include "RayTrace.h"
+#include "animation.h"
+#include "antialias.h"
+#include "checkpoint.h"
+#include "heatmap.h"
 #include "master.h"
+#include "options.h"
+#include "scene.h"
 #include "slave.h"
+#include "threads.h"
+#include "timing.h"
 
 int main( int argc, char* argv[] ) 
 {
     //Keep the data that will be used for the scene.
     ConfigData data;
     
-    //Try to initialize the scene.
-    bool result = initialize(&argc, &argv, &data);
+    //Pull out the options that the library does not know about.
+    bool result = parseRenderOptions(&argc, &argv);
+
+    //MPI Intialization
+    //Only the main thread of each process makes MPI calls.
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+
+    //Copy the scene files to every node once and then try to initialize
+    //the scene from the copy.
+    if( !result )
+    {
+        stageScene(argc, argv);
+    }
+    result = result || initialize(&argc, &argv, &data);
     //Make sure that the initialization was completed.	
     if( result )
     {
         MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
     }
-
-    //MPI Intialization
-    MPI_Init(&argc, &argv);
     MPI_Comm_rank(MPI_COMM_WORLD, &data.mpi_rank);
     MPI_Comm_size(MPI_COMM_WORLD, &data.mpi_procs);
+    applyRenderOptions(&data);
+
+    //Load the scene for the extra anti-aliasing samples, and start the
+    //threads that help this process shade its pixels.
+    if( startAntialiasing(&data) )
+    {
+        cerr << "Could not load the scene for anti-aliasing!" << endl;
+        MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+    }
+    if( startThreads(&data) )
+    {
+        cerr << "Could not load the scene for every thread!" << endl;
+        MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+    }
+    //Read the keyframes of the camera. The scene is loaded again for every
+    //frame of an animation, so the staged files are kept until the end.
+    int frames = startAnimation(&data);
+    if( frames == 0 )
+    {
+        MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+    }
+    if( renderOptions.framesFile == NULL )
+    {
+        unstageScene();
+    }
 
     if( data.mpi_rank == 0 )
     {
@@ -57,18 +100,52 @@ int main( int argc, char* argv[] )
         //Print out the other properties as well
         std::cout << "Dynamic block size: " << data.dynamicBlockWidth << " x " << data.dynamicBlockHeight << std::endl;
         std::cout << "Cycle Size: " << data.cycleSize << std::endl; 
+    }
 
-        //Start the main processing for the ray tracer.
-        masterMain( &data );
+    //Save the pixels as they are shaded, and take back the ones that an
+    //earlier run already saved.
+    if( startCheckpoint(&data) )
+    {
+        MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
     }
-    else
+
+    //Render every frame, one after another.
+    for( int frame = 0; frame < frames; frame++ )
     {
-        slaveMain( &data );
+        if( setFrame(&data, frame) )
+        {
+            cerr << "Could not move the camera to frame " << frame << "!" << endl;
+            MPI_Abort(MPI_COMM_WORLD, MPI_ERR_OTHER);
+        }
+        startHeatmap(&data);
+
+        if( data.mpi_rank == 0 )
+        {
+            if( frames > 1 )
+            {
+                std::cout << "Frame " << frame + 1 << " of " << frames << std::endl;
+            }
+
+            //Start the main processing for the ray tracer.
+            masterMain( &data );
+        }
+        else
+        {
+            slaveMain( &data );
+        }
     }
+    finishAnimation();
+    finishCheckpoint(&data);
+    unstageScene();
+
+    //Gather the time that every process spent on each part of the render.
+    reportTiming(&data);
 
     std::cout << "Process " << data.mpi_rank << " finished." << std::endl;
 
     //Clean up the scene and other data.
+    stopThreads();
+    stopAntialiasing();
     shutdown(&data);
     //Finalize the MPI environment.
     MPI_Finalize();
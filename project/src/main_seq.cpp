@@ -13,6 +13,7 @@
 using namespace std;
 
 #include "RayTrace.h"
+#include "shade.h"
 
 int main( int argc, char* argv[] ) 
 {
@@ -55,20 +56,7 @@ int main( int argc, char* argv[] )
     clock_t start = clock();
 
     //Render the scene.
-    for( int i = 0; i < data.height; ++i )
-    {
-        for( int j = 0; j < data.width; ++j )
-        {
-            int row = i;
-            int column = j;
-
-            //Calculate the index into the array.
-            int baseIndex = 3 * ( row * data.width + column );
-
-            //Call the function to shade the pixel.
-            shadePixel(&(pixels[baseIndex]),row,j,&data);
-        }
-    }
+    shadeTile(pixels, 0, 0, data.width, data.height, data.width, &data);
 
     //Stop the timing.
     clock_t stop = clock();
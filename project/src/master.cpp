@@ -1,11 +1,31 @@
 //This file contains the code that the master process will execute.
 
+#include <algorithm>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <map>
+#include <vector>
 #include <mpi.h>
 #include <unistd.h>
 
 #include "RayTrace.h"
+#include "animation.h"
+#include "antialias.h"
+#include "balance.h"
+#include "heatmap.h"
+#include "image.h"
 #include "master.h"
+#include "options.h"
+#include "partition.h"
+#include "stealing.h"
+#include "threads.h"
+#include "tiles.h"
+#include "timing.h"
+#include "tone.h"
+#include "wire.h"
+
+static void finishLateResults();
 
 void masterMain(ConfigData* data)
 {
@@ -13,8 +33,26 @@ void masterMain(ConfigData* data)
     //You should have a different function for each of the required 
     //schemes that returns some values that you need to handle.
     
-    //Allocate space for the image on the master.
-    float* pixels = new float[3 * data->width * data->height];
+    //When streaming, the image is opened before rendering so that rows
+    //can be written out as soon as they are finished.
+    std::string file = frameFileName();
+    ImageWriter* stream = NULL;
+    if (renderOptions.streamFormat != NULL)
+    {
+        file = file.substr(0, file.find_last_of('.')) + "." + renderOptions.streamFormat;
+        stream = openImage(file, data);
+    }
+
+    //Allocate space for the image on the master. When streaming, the
+    //dynamic scheme only keeps a window of rows in memory instead, unless
+    //the whole image is needed to find the edges for anti-aliasing or to
+    //tone map it, or the tiles are not handed out row by row.
+    float* pixels = NULL;
+    if (stream == NULL || data->partitioningMode != PART_MODE_DYNAMIC || data->mpi_procs < 2 ||
+        renderOptions.antialiasing > 1 || toneMapping() || renderOptions.tileOrder != ORDER_ROWS)
+    {
+        pixels = new float[3 * data->width * data->height];
+    }
     
     //Execution time will be defined as how long it takes
     //for the given function to execute based on partitioning
@@ -32,7 +70,7 @@ void masterMain(ConfigData* data)
 	//called.
 	//It is suggested that you use the same parameters to your functions as shown
 	//in the sequential example below.
-    switch (data->partitioningMode)
+    switch ((int)data->partitioningMode)
     {
         case PART_MODE_NONE:
             //Call the function that will handle this.
@@ -40,7 +78,25 @@ void masterMain(ConfigData* data)
             masterSequential(data, pixels);
             stopTime = MPI_Wtime();
             break;
+        case PART_MODE_STATIC_STRIPS_HORIZONTAL:
+            //Call the function that will handle this.
+            startTime = MPI_Wtime();
+            masterStaticStripsHorizontal(data, pixels);
+            stopTime = MPI_Wtime();
+            break;
         case PART_MODE_STATIC_STRIPS_VERTICAL:
+            //Call the function that will handle this.
+            startTime = MPI_Wtime();
+            masterStaticStripsVertical(data, pixels);
+            stopTime = MPI_Wtime();
+            break;
+        case PART_MODE_STATIC_CYCLES_HORIZONTAL:
+            //Call the function that will handle this.
+            startTime = MPI_Wtime();
+            masterStaticCyclesHorizontal(data, pixels);
+            stopTime = MPI_Wtime();
+            break;
+        case PART_MODE_STATIC_CYCLES_VERTICAL:
             //Call the function that will handle this.
             startTime = MPI_Wtime();
             masterStaticCyclesVertical(data, pixels);
@@ -52,23 +108,72 @@ void masterMain(ConfigData* data)
             masterStaticBlocks(data, pixels);
             stopTime = MPI_Wtime();
             break;
+        case PART_MODE_DYNAMIC:
+            //Call the function that will handle this.
+            startTime = MPI_Wtime();
+            if (data->mpi_procs < 2)
+            {
+                //There is nobody to hand the tiles to, so render it here.
+                std::cout << "Dynamic partitioning requires at least 2 processes." << std::endl;
+                masterSequential(data, pixels);
+            }
+            else
+            {
+                masterDynamic(data, pixels, stream);
+            }
+            stopTime = MPI_Wtime();
+            break;
+        case PART_MODE_WORK_STEALING:
+            //Call the function that will handle this.
+            startTime = MPI_Wtime();
+            masterWorkStealing(data, pixels);
+            stopTime = MPI_Wtime();
+            break;
+        case PART_MODE_STATIC_COST:
+            //Call the function that will handle this.
+            startTime = MPI_Wtime();
+            masterStaticCost(data, pixels);
+            stopTime = MPI_Wtime();
+            break;
         default:
             std::cout << "This mode (" << data->partitioningMode;
             std::cout << ") is not currently implemented." << std::endl;
             break;
     }
 
+    //Take more samples along the edges of the image.
+    refineEdges(data, pixels);
+    stopTime = MPI_Wtime();
+
     renderTime = stopTime - startTime;
+    recordTime(TIME_TOTAL, renderTime);
     std::cout << "Execution Time: " << renderTime << " seconds" << std::endl << std::endl;
 
     //After this gets done, save the image.
     std::cout << "Image will be save to: ";
-    std::string file = "renders/" + generateFileName();
     std::cout << file << std::endl;
-    savePixels(file, pixels, data);
+    if (stream != NULL)
+    {
+        //Write whatever has not been streamed yet.
+        if (pixels != NULL)
+        {
+            writeRows(stream, pixels, data->height);
+        }
+        closeImage(stream);
+
+        //Delete the pixel data.
+        delete[] pixels;
+    }
+    else
+    {
+        //The pixel data is deleted once it has been saved.
+        saveFrame(file, pixels, data);
+    }
 
-    //Delete the pixel data.
-    delete[] pixels; 
+    //The image is saved, so now wait for the slaves that were still busy
+    //with tiles that someone else returned first.
+    finishLateResults();
+    finishHeatmap(data, file);
 }
 
 void masterSequential(ConfigData* data, float* pixels)
@@ -77,28 +182,16 @@ void masterSequential(ConfigData* data, float* pixels)
     double computationStart = MPI_Wtime();
 
     //Render the scene.
-    for( int i = 0; i < data->height; i++ )
-    {
-        for( int j = 0; j < data->width; j++ )
-        {
-            int row = i;
-            int column = j;
-
-            //Calculate the index into the array.
-            int baseIndex = 3 * ( row * data->width + column );
+    shadeRegion(pixels, 0, 0, data->width, data->height, data->width, data);
 
-            //Call the function to shade the pixel.
-            shadePixel(&(pixels[baseIndex]),row,j,data);
-        }
-    }
+    //After receiving from all processes, the communication time will
+    //be obtained.
+    double communicationTime = combineLuminance();
+    toneMapRegion(pixels, data->width, data->height, data->width);
 
     //Stop the comp. timer
     double computationStop = MPI_Wtime();
-    double computationTime = computationStop - computationStart;
-
-    //After receiving from all processes, the communication time will
-    //be obtained.
-    double communicationTime = 0.0;
+    double computationTime = computationStop - computationStart - communicationTime;
 
     //Print the times and the c-to-c ratio
 	//This section of printing, IN THIS ORDER, needs to be included in all of the
@@ -109,92 +202,513 @@ void masterSequential(ConfigData* data, float* pixels)
     std::cout << "C-to-C Ratio: " << c2cRatio << std::endl;
 }
 
+//Renders the regions of the static strips and blocks schemes, where
+//regions[i] belongs to process i. The receives for every band of the
+//slaves (see bandRows()) are posted straight into the image up front. The
+//master then shades its own region a band at a time, and takes in the
+//bands that have arrived in between, so that MPI keeps the transfers of
+//the slaves moving while it shades. The rest are taken in the order that
+//they arrive. Returns the time spent communicating.
+static double renderRegions(ConfigData* data, float* pixels, const std::vector<Tile>& regions)
+{
+    double communicationTime = 0.0;
+    std::vector<Tile> bands;
+    std::vector<int> sources;
+    for (int i = 1; i < data->mpi_procs; i++)
+    {
+        Tile band = regions[i];
+        int rows = bandRows(band.height);
+        for (int row = 0; row < regions[i].height; row += rows)
+        {
+            band.row = regions[i].row + row;
+            band.height = std::min(rows, regions[i].height - row);
+            bands.push_back(band);
+            sources.push_back(i);
+        }
+    }
+    std::vector<PixelTransfer> transfers(bands.size());
+    std::vector<MPI_Datatype> types(bands.size());
+    for (size_t i = 0; i < bands.size(); i++)
+    {
+        types[i] = blockType(data, bands[i]);
+        startReceivePixels(pixels, 1, types[i], sources[i], 0, &transfers[i]);
+    }
+    PixelTransfer* pending = transfers.empty() ? NULL : &transfers[0];
+
+    //The master renders its region straight into the image, and tone maps
+    //it once the luminance of the whole image is known.
+    Tile region = regions[0];
+    float* start = &(pixels[3 * (region.row * data->width + region.column)]);
+    int rows = bandRows(region.height);
+    for (int row = 0; row < region.height; row += rows)
+    {
+        shadeRegion(&(start[3 * row * data->width]), region.row + row, region.column, region.width,
+            std::min(rows, region.height - row), data->width, data);
+
+        double communicationStart = MPI_Wtime();
+        while (testAnyPixels(pending, transfers.size()) != MPI_UNDEFINED)
+        {
+        }
+        communicationTime += MPI_Wtime() - communicationStart;
+    }
+    communicationTime += combineLuminance();
+    toneMapRegion(start, region.width, region.height, data->width);
+
+    //Wait for the rest of the bands of the slaves.
+    double communicationStart = MPI_Wtime();
+    while (finishAnyPixels(pending, transfers.size()) != MPI_UNDEFINED)
+    {
+    }
+    communicationTime += MPI_Wtime() - communicationStart;
+
+    for (size_t i = 0; i < types.size(); i++)
+    {
+        MPI_Type_free(&types[i]);
+    }
+    return communicationTime;
+}
+
 void masterStaticBlocks(ConfigData* data, float* pixels)
 {
     //Start the computation time timer.
     double computationStart = MPI_Wtime();
 
-    //Calculate the number of pixels per block (X direction)
-    int pixelsPerBlockX = data->width / data->mpi_procs;
-    int pixelsPerBlockY = data->height / data->mpi_procs;
-    //Need to handle remainder in case of odd sized widths or processor numbers
-    int pixelsPerBlockRemainderX = data->width % data->mpi_procs;
-    int pixelsPerBlockRemainderY = data->height % data->mpi_procs;
+    //Every process can work out its own block, so nothing has to be sent
+    //out before rendering.
+    std::vector<Tile> blocks(data->mpi_procs);
+    for (int i = 0; i < data->mpi_procs; i++)
+    {
+        blocks[i] = blockAt(data, i);
+    }
+    double communicationTime = renderRegions(data, pixels, blocks);
+
+    recordTime(TIME_WAIT, communicationTime);
+
+    //Stop the comp. timer
+    double computationStop = MPI_Wtime();
+    double computationTime = computationStop - computationStart - communicationTime;
+
+    //Print the times and the c-to-c ratio
+    //This section of printing, IN THIS ORDER, needs to be included in all of the
+    //functions that you write at the end of the function.
+    std::cout << "Total Computation Time: " << computationTime << " seconds" << std::endl;
+    std::cout << "Total Communication Time: " << communicationTime << " seconds" << std::endl;
+    double c2cRatio = communicationTime / computationTime;
+    std::cout << "C-to-C Ratio: " << c2cRatio << std::endl;
+}
+
+void masterStaticStripsVertical(ConfigData* data, float* pixels)
+{
+    //Start the computation time timer.
+    double computationStart = MPI_Wtime();
 
-    //Distribute the parameters to each process
-    ConfigData* blockData = new ConfigData[data->mpi_procs];
+    //Every process renders one strip of consecutive columns.
+    std::vector<Tile> strips(data->mpi_procs);
     for (int i = 0; i < data->mpi_procs; i++)
     {
-        blockData[i] = *data;
-        blockData[i].width = pixelsPerBlockX;
-        blockData[i].height = pixelsPerBlockY;
-        blockData[i].partitioningMode = PART_MODE_STATIC_BLOCKS;
-        blockData[i].cycleSize = data->cycleSize;
-        blockData[i].dynamicBlockWidth = data->dynamicBlockWidth;
-        blockData[i].dynamicBlockHeight = data->dynamicBlockHeight;
+        strips[i].row = 0;
+        strips[i].height = data->height;
+        strips[i].column = stripStart(data->width, data->mpi_procs, i);
+        strips[i].width = stripStart(data->width, data->mpi_procs, i + 1) - strips[i].column;
+    }
+    double communicationTime = renderRegions(data, pixels, strips);
+
+    recordTime(TIME_WAIT, communicationTime);
+
+    //Stop the comp. timer
+    double computationStop = MPI_Wtime();
+    double computationTime = computationStop - computationStart - communicationTime;
+
+    //Print the times and the c-to-c ratio
+    //This section of printing, IN THIS ORDER, needs to be included in all of the
+    //functions that you write at the end of the function.
+    std::cout << "Total Computation Time: " << computationTime << " seconds" << std::endl;
+    std::cout << "Total Communication Time: " << communicationTime << " seconds" << std::endl;
+    double c2cRatio = communicationTime / computationTime;
+    std::cout << "C-to-C Ratio: " << c2cRatio << std::endl;
+}
+
+//A tile is reissued to an idle slave once every slave that holds it has
+//taken this many times the median time to shade a tile (and at least
+//MIN_LATE_SECONDS) on it. The tile behind it in a slave's queue gets twice
+//as long, and so on.
+#define LATE_FACTOR 4.0
+#define MIN_LATE_SECONDS 0.01
+
+//How long the master sleeps between looking for results while it watches
+//for late tiles, in microseconds.
+#define POLL_MICROSECONDS 500
 
-        std::cout << "Process " << i << " will handle a block of size " << blockData[i].width << " x " << blockData[i].height << std::endl;
+//Keeps track of the tiles that the master hands out in the dynamic scheme.
+typedef struct
+{
+    int tileWidth;
+    int tileHeight;
+    int tilesX;
+    int totalTiles;
+
+    //The tiles in the order that they are handed out in (see tileOrder()),
+    //and the position in it of the next tile to hand out.
+    std::vector<int> order;
+    int nextTile;
+
+    //Tiles are only handed out for rows of tiles before this one.
+    int windowEnd;
+
+    //The tiles that each slave has been given but has not returned yet,
+    //oldest first. A slave always returns its tiles in the order that it
+    //received them.
+    std::vector< std::deque<int> > outstanding;
+
+    //When each slave started on the tile at the front of its queue.
+    std::vector<double> started;
+
+    //How many slaves hold each tile, and whether it has come back yet.
+    std::vector<int> copies;
+    std::vector<char> done;
+
+    //How long the slaves took to shade the tiles that came back, and their
+    //median, which is worked out again whenever it is needed and there are
+    //new times.
+    std::vector<double> shadeTimes;
+    double median;
+    size_t medianSamples;
+    int reissued;
+} TileQueue;
+
+//Results of copies of tiles that are still being shaded once the image is
+//complete. They are received in the background and thrown away.
+static std::vector<PixelTransfer> lateTransfers;
+static std::vector< std::vector<float> > lateBuffers;
+
+//Gives a tile to a slave.
+static void sendTile(TileQueue* queue, int slave, int index)
+{
+    if (queue->outstanding[slave].empty())
+    {
+        queue->started[slave] = MPI_Wtime();
+    }
+    queue->outstanding[slave].push_back(index);
+    queue->copies[index]++;
+    MPI_Send(&index, 1, MPI_INT, slave, TAG_TILE_ASSIGN, MPI_COMM_WORLD);
+}
 
-        //If there is a remainder, add the remainder to the width of the last process
-        if (i == data->mpi_procs - 1 && pixelsPerBlockRemainderX > 0)
+//Tops up the tiles that the given slave has in its queue. Slaves are only
+//told to stop once the whole image is back, so that the ones that run out
+//of tiles can still take over tiles from slow slaves.
+static void assignTiles(TileQueue* queue, int slave)
+{
+    while (queue->nextTile < queue->totalTiles && (int)queue->outstanding[slave].size() < TILES_IN_FLIGHT)
+    {
+        //Hold the tile back if its rows are not in the window yet.
+        int index = queue->order[queue->nextTile];
+        if (index / queue->tilesX >= queue->windowEnd)
         {
-            blockData[i].width += pixelsPerBlockRemainderX;
+            return;
         }
-        //If there is a remainder, add the remainder to the height of the last process
-        if (i == data->mpi_procs - 1 && pixelsPerBlockRemainderY > 0)
+        sendTile(queue, slave, index);
+        queue->nextTile++;
+    }
+}
+
+//Returns the median time that the slaves took to shade a tile, or 0 before
+//any tile has come back.
+static double medianShadeTime(TileQueue* queue)
+{
+    if (queue->shadeTimes.size() != queue->medianSamples)
+    {
+        std::vector<double> times = queue->shadeTimes;
+        std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+        queue->median = times[times.size() / 2];
+        queue->medianSamples = times.size();
+    }
+    return queue->medianSamples > 0 ? queue->median : 0.0;
+}
+
+//Gives an idle slave a copy of the oldest tile that is late on every slave
+//that holds it. Returns true if a tile was given out.
+static bool reissueLateTile(TileQueue* queue, int slave)
+{
+    double median = medianShadeTime(queue);
+    if (median <= 0.0)
+    {
+        return false;
+    }
+
+    //Count how many of the copies of each tile are late.
+    double now = MPI_Wtime();
+    std::map<int, int> late;
+    for (size_t holder = 1; holder < queue->outstanding.size(); holder++)
+    {
+        const std::deque<int>& tiles = queue->outstanding[holder];
+        for (size_t position = 0; position < tiles.size(); position++)
         {
-            blockData[i].height += pixelsPerBlockRemainderY;
+            double allowed = std::max(MIN_LATE_SECONDS, LATE_FACTOR * median) * (position + 1);
+            if (now - queue->started[holder] > allowed)
+            {
+                late[tiles[position]]++;
+            }
         }
     }
-    //Send the data to each process
-    for (int i = 1; i < data->mpi_procs; i++)
+    for (std::map<int, int>::iterator tile = late.begin(); tile != late.end(); tile++)
     {
-        MPI_Send(&blockData[i], sizeof(ConfigData), MPI_BYTE, i, 0, MPI_COMM_WORLD);
-        MPI_Send(pixels, 3 * blockData[i].width * blockData[i].height, MPI_FLOAT, i, 0, MPI_COMM_WORLD);
+        if (!queue->done[tile->first] && tile->second == queue->copies[tile->first])
+        {
+            sendTile(queue, slave, tile->first);
+            queue->reissued++;
+            return true;
+        }
     }
+    return false;
+}
 
-    //The master process will handle the first strip
-    //Render the scene.
-    for( int i = 0; i < blockData[0].height; i++ )
+//Waits for the next message from a slave. While any slave has nothing to
+//do, the master polls instead of blocking so that it can hand that slave
+//the tiles that are running late elsewhere.
+static void waitForResult(TileQueue* queue, MPI_Status* status)
+{
+    while (true)
     {
-        for( int j = 0; j < blockData[0].width; j++ )
+        bool idle = false;
+        for (size_t slave = 1; slave < queue->outstanding.size(); slave++)
+        {
+            if (queue->outstanding[slave].empty() && !reissueLateTile(queue, slave))
+            {
+                idle = true;
+            }
+        }
+        if (!idle)
         {
-            int row = i;
-            int column = j;
+            MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, status);
+            return;
+        }
 
-            //Calculate the index into the array
-            int baseIndex = 3 * ( row * data->width + column );
-            //Call the function to shade the pixel.
-            shadePixel(&(pixels[baseIndex]),row,j,data);
+        int found;
+        MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &found, status);
+        if (found)
+        {
+            return;
         }
+        usleep(POLL_MICROSECONDS);
     }
-    //Receive the data from each process
-    for (int i = 1; i < data->mpi_procs; i++)
+}
+
+//Receives the results of the copies of tiles that slaves are still
+//shading, without waiting for them.
+static void startLateResults(TileQueue* queue)
+{
+    int count = 0;
+    for (size_t slave = 1; slave < queue->outstanding.size(); slave++)
+    {
+        count += queue->outstanding[slave].size();
+    }
+    lateTransfers.resize(count);
+    lateBuffers.resize(count);
+    int next = 0;
+    for (size_t slave = 1; slave < queue->outstanding.size(); slave++)
     {
-        std::cout << "Waiting for strip " << i << std::endl;
-        //Receive the pixels from each process
-        float blockPixels[3 * blockData[i].width * blockData[i].height];
-        MPI_Recv(blockPixels, 3 * blockData[i].width * blockData[i].height, MPI_FLOAT, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        std::cout << "Received strip " << i << std::endl;
+        for (size_t i = 0; i < queue->outstanding[slave].size(); i++, next++)
+        {
+            //The buffer fits the result of any tile, and a skipped tile
+            //sends nothing at all.
+            lateBuffers[next].resize(3 * queue->tileWidth * queue->tileHeight);
+            startReceivePixels(&lateBuffers[next][0], lateBuffers[next].size(), MPI_FLOAT, slave,
+                MPI_ANY_TAG, &lateTransfers[next]);
+        }
+    }
+}
+
+//Waits for the results that were started by startLateResults().
+static void finishLateResults()
+{
+    finishPixels(lateTransfers.empty() ? NULL : &lateTransfers[0], lateTransfers.size());
+    lateTransfers.clear();
+    lateBuffers.clear();
+}
+
+void masterDynamic(ConfigData* data, float* pixels, ImageWriter* stream)
+{
+    //Start the computation time timer.
+    double computationStart = MPI_Wtime();
+    double communicationTime = 0.0;
+    double communicationStart;
+
+    TileQueue queue;
+    queue.tileWidth = data->dynamicBlockWidth;
+    queue.tileHeight = data->dynamicBlockHeight;
+    queue.tilesX = (data->width + queue.tileWidth - 1) / queue.tileWidth;
+    queue.totalTiles = tileCount(data, queue.tileWidth, queue.tileHeight);
+    queue.order = tileOrder(data, queue.tileWidth, queue.tileHeight);
+    queue.nextTile = 0;
+    queue.outstanding.resize(data->mpi_procs);
+    queue.started.resize(data->mpi_procs, 0.0);
+    queue.copies.resize(queue.totalTiles, 0);
+    queue.done.resize(queue.totalTiles, 0);
+    queue.median = 0.0;
+    queue.medianSamples = 0;
+    queue.reissued = 0;
+
+    int tileRows = (queue.totalTiles + queue.tilesX - 1) / queue.tilesX;
+    queue.windowEnd = tileRows;
+
+    //When the rows are streamed to disk, only a window of rows of tiles is
+    //kept in memory. It holds enough rows for every slave to have a full
+    //queue of tiles, plus the row that is being waited on.
+    bool streaming = (pixels == NULL);
+    int windowRows = tileRows;
+    int writtenRows = 0;
+    std::vector<int> tilesLeft;
+    if (streaming)
+    {
+        int inFlight = (data->mpi_procs - 1) * TILES_IN_FLIGHT;
+        windowRows = (inFlight + queue.tilesX - 1) / queue.tilesX + 1;
+        queue.windowEnd = windowRows;
+        pixels = new float[3 * data->width * queue.tileHeight * windowRows];
+        tilesLeft.resize(tileRows, queue.tilesX);
+    }
+
+    //Give every slave enough tiles to keep it busy while the results of
+    //the first one are on their way back.
+    communicationStart = MPI_Wtime();
+    for (int slave = 1; slave < data->mpi_procs; slave++)
+    {
+        assignTiles(&queue, slave);
+    }
+    communicationTime += MPI_Wtime() - communicationStart;
 
-        //Consolidate the strips into one image, stored in the master process
-        for (int row = (pixelsPerBlockY*(i+1)); row < blockData[i].height; row++)
-        {   
-            for (int column = (pixelsPerBlockX*(i+1)); column < blockData[i].width; column++)
+    //The results of copies of tiles that already came back are received
+    //here and thrown away.
+    std::vector<float> discarded(3 * queue.tileWidth * queue.tileHeight);
+
+    int finished = 0;
+    while (finished < queue.totalTiles)
+    {
+        //Take the results from whichever slave finishes first.
+        communicationStart = MPI_Wtime();
+        MPI_Status status;
+        waitForResult(&queue, &status);
+        int slave = status.MPI_SOURCE;
+        int index = queue.outstanding[slave].front();
+        queue.outstanding[slave].pop_front();
+        queue.copies[index]--;
+        double now = MPI_Wtime();
+        double shadeTime = now - queue.started[slave];
+        queue.started[slave] = now;
+
+        Tile tile = tileAt(data, queue.tileWidth, queue.tileHeight, index);
+        int tileRow = index / queue.tilesX;
+        bool first = false;
+        if (status.MPI_TAG == TAG_TILE_SKIPPED)
+        {
+            //The slave dropped a copy of a tile that had already come back.
+            MPI_Recv(NULL, 0, MPI_INT, slave, TAG_TILE_SKIPPED, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        }
+        else if (queue.done[index])
+        {
+            receivePixels(&discarded[0], 3 * tile.width * tile.height, MPI_FLOAT, slave,
+                TAG_TILE_RESULT);
+            queue.shadeTimes.push_back(shadeTime);
+        }
+        else
+        {
+            //Receive the tile straight into its place in the image, or in
+            //the window when streaming.
+            int firstRow = (tileRow % windowRows) * queue.tileHeight;
+            MPI_Datatype type;
+            MPI_Type_vector(tile.height, 3 * tile.width, 3 * data->width, MPI_FLOAT, &type);
+            MPI_Type_commit(&type);
+            receivePixels(&(pixels[3 * (firstRow * data->width + tile.column)]), 1, type, slave,
+                TAG_TILE_RESULT);
+            MPI_Type_free(&type);
+            queue.shadeTimes.push_back(shadeTime);
+            queue.done[index] = 1;
+            finished++;
+            first = true;
+
+            //Tell the slaves that hold other copies of the tile to skip it.
+            for (int holder = 1; holder < data->mpi_procs && queue.copies[index] > 0; holder++)
             {
-                int baseIndex = 3 * (row * blockData->width + column);
-                pixels[baseIndex] = blockPixels[baseIndex];
+                const std::deque<int>& tiles = queue.outstanding[holder];
+                if (std::find(tiles.begin(), tiles.end(), index) != tiles.end())
+                {
+                    int cancel = TILE_CANCEL(index);
+                    MPI_Send(&cancel, 1, MPI_INT, holder, TAG_TILE_ASSIGN, MPI_COMM_WORLD);
+                }
             }
         }
+
+        //Refill the slave's queue before doing anything else with the tile.
+        assignTiles(&queue, slave);
+        communicationTime += MPI_Wtime() - communicationStart;
+
+        if (!streaming || !first)
+        {
+            continue;
+        }
+
+        //Write out every row of tiles at the top of the window that is
+        //complete, and let the window move down over the rows after it.
+        tilesLeft[tileRow]--;
+        int windowStart = writtenRows;
+        while (writtenRows < tileRows && tilesLeft[writtenRows] == 0)
+        {
+            int rows = std::min(queue.tileHeight, data->height - writtenRows * queue.tileHeight);
+            int slot = (writtenRows % windowRows) * queue.tileHeight;
+            double copyStart = MPI_Wtime();
+            writeRows(stream, &(pixels[3 * slot * data->width]), rows);
+            recordTime(TIME_COPY, MPI_Wtime() - copyStart);
+            writtenRows++;
+        }
+        if (writtenRows != windowStart)
+        {
+            queue.windowEnd = writtenRows + windowRows;
+            communicationStart = MPI_Wtime();
+            for (int i = 1; i < data->mpi_procs; i++)
+            {
+                assignTiles(&queue, i);
+            }
+            communicationTime += MPI_Wtime() - communicationStart;
+        }
+    }
+
+    //Tell every slave to stop, and let the slaves that are still shading
+    //copies of tiles that came back from someone else finish in the
+    //background, so that they do not hold up the image.
+    communicationStart = MPI_Wtime();
+    int none = TILE_NONE;
+    for (int slave = 1; slave < data->mpi_procs; slave++)
+    {
+        MPI_Send(&none, 1, MPI_INT, slave, TAG_TILE_ASSIGN, MPI_COMM_WORLD);
+    }
+    startLateResults(&queue);
+    communicationTime += MPI_Wtime() - communicationStart;
+
+    if (streaming)
+    {
+        delete[] pixels;
     }
 
+    //The tiles were sent before the luminance of the whole image was known,
+    //so they are tone mapped here. Some tiles may have been shaded by more
+    //than one slave, so the master measures the luminance of the image
+    //itself rather than adding up what the slaves shaded.
+    if (!streaming)
+    {
+        measureLuminance(pixels, data->width, data->height, data->width);
+    }
+    communicationTime += combineLuminance();
+    if (!streaming)
+    {
+        toneMapRegion(pixels, data->width, data->height, data->width);
+    }
+
+    recordTime(TIME_WAIT, communicationTime);
+
+    std::cout << "Tiles Reissued To Other Slaves: " << queue.reissued << std::endl;
+
     //Stop the comp. timer
     double computationStop = MPI_Wtime();
-    double computationTime = computationStop - computationStart;
-
-    //After receiving from all processes, the communication time will
-    //be obtained.
-    double communicationTime = 0.0;
+    double computationTime = computationStop - computationStart - communicationTime;
 
     //Print the times and the c-to-c ratio
     //This section of printing, IN THIS ORDER, needs to be included in all of the
@@ -205,103 +719,278 @@ void masterStaticBlocks(ConfigData* data, float* pixels)
     std::cout << "C-to-C Ratio: " << c2cRatio << std::endl;
 }
 
-
-void masterStaticCyclesVertical(ConfigData* data, float* pixels)
+void masterWorkStealing(ConfigData* data, float* pixels)
 {
     //Start the computation time timer.
     double computationStart = MPI_Wtime();
 
-    //Calculate the number of pixels per vertical strip
-    int pixelsPerStrip = data->width / data->mpi_procs;
-    //Need to handle remainder in case of odd sized widths or processor numbers
-    int pixelsPerStripRemainder = data->width % data->mpi_procs;
+    //Render our share of the tiles along with everyone else.
+    std::vector<int> tiles;
+    std::vector<float> tilePixels;
+    double communicationTime = 0.0;
+    renderWorkStealing(data, &tiles, &tilePixels, &communicationTime);
 
-    int width[data->mpi_procs];
-    int height[data->mpi_procs];
+    //Tone map our tiles once the luminance of the whole image is known.
+    communicationTime += combineLuminance();
+    toneMapRegion(tilePixels.empty() ? NULL : &tilePixels[0], tilePixels.size() / 3, 1, 0);
 
-    //Distribute the parameters to each process
-    for (int i = 0; i < data->mpi_procs; i++)
+    double communicationStart = MPI_Wtime();
+    int tileWidth = data->dynamicBlockWidth;
+    int tileHeight = data->dynamicBlockHeight;
+
+    //Find out which tiles every process rendered.
+    int count = tiles.size();
+    std::vector<int> counts(data->mpi_procs);
+    MPI_Gather(&count, 1, MPI_INT, &counts[0], 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    std::vector<int> displacements(data->mpi_procs, 0);
+    for (int i = 1; i < data->mpi_procs; i++)
     {
-        width[i] = pixelsPerStrip;
-        height[i] = data->height;
-        std::cout << "Process " << i << " will handle a strip of size " << width[i] << " x " << height[i] << std::endl;
+        displacements[i] = displacements[i - 1] + counts[i - 1];
+    }
+    std::vector<int> allTiles(tileCount(data, tileWidth, tileHeight));
+    MPI_Gatherv(tiles.empty() ? NULL : &tiles[0], count, MPI_INT, &allTiles[0],
+        &counts[0], &displacements[0], MPI_INT, 0, MPI_COMM_WORLD);
 
-        //If there is a remainder, add the remainder to the width of the last process
-        if (i == data->mpi_procs - 1 && pixelsPerStripRemainder > 0)
+    //Receive the tiles of the slaves straight into the image.
+    std::vector<PixelTransfer> transfers(data->mpi_procs - 1);
+    std::vector<MPI_Datatype> types(data->mpi_procs, MPI_DATATYPE_NULL);
+    for (int i = 1; i < data->mpi_procs; i++)
+    {
+        types[i] = tilesType(data, &allTiles[0] + displacements[i], counts[i]);
+        startReceivePixels(pixels, 1, types[i], i, 0, &transfers[i - 1]);
+    }
+
+    //Copy our own tiles into the image one row at a time while they arrive.
+    double copyStart = MPI_Wtime();
+    size_t offset = 0;
+    for (int i = 0; i < count; i++)
+    {
+        Tile tile = tileAt(data, tileWidth, tileHeight, tiles[i]);
+        for (int row = 0; row < tile.height; row++)
         {
-            width[i] += pixelsPerStripRemainder;
+            int baseIndex = 3 * ((tile.row + row) * data->width + tile.column);
+            memcpy(&(pixels[baseIndex]), &(tilePixels[offset]), 3 * tile.width * sizeof(float));
+            offset += 3 * tile.width;
         }
     }
-    std::cout << "Sending data to each process" << std::endl;
-    //Send the data to each process
+    double copyTime = MPI_Wtime() - copyStart;
+    recordTime(TIME_COPY, copyTime);
+
+    finishPixels(transfers.empty() ? NULL : &transfers[0], transfers.size());
     for (int i = 1; i < data->mpi_procs; i++)
     {
-        std::cout << "Sending data to process " << i << std::endl;
-        MPI_Send(&width[i], sizeof(int), MPI_BYTE, i, 0, MPI_COMM_WORLD);
-        MPI_Send(&height[i], sizeof(int), MPI_BYTE, i, 0, MPI_COMM_WORLD);
-        std::cout << "Sending offset to process " << i << std::endl;
-        int offset = (width[i-1] * i);
-        MPI_Send(&offset, sizeof(int), MPI_BYTE, i, 0, MPI_COMM_WORLD);
-        std::cout << "Sending pixels to process " << i << std::endl;
-        long pixels_size = 3 * (width[i] * height[i]);
-        std::cout << "Pixels size: " << pixels_size << std::endl;
-        MPI_Send(pixels, pixels_size, MPI_FLOAT, i, 0, MPI_COMM_WORLD);
-    }
-    std::cout << "Master beginning to render" << std::endl;
-    //The master process will handle the first strip
-    //Render the scene.
-    for( int row = 0; row < height[0]; row++ )
+        MPI_Type_free(&types[i]);
+    }
+    communicationTime += MPI_Wtime() - communicationStart - copyTime;
+
+    recordTime(TIME_WAIT, communicationTime);
+
+    //Stop the comp. timer
+    double computationStop = MPI_Wtime();
+    double computationTime = computationStop - computationStart - communicationTime;
+
+    //Print the times and the c-to-c ratio
+    //This section of printing, IN THIS ORDER, needs to be included in all of the
+    //functions that you write at the end of the function.
+    std::cout << "Total Computation Time: " << computationTime << " seconds" << std::endl;
+    std::cout << "Total Communication Time: " << communicationTime << " seconds" << std::endl;
+    double c2cRatio = communicationTime / computationTime;
+    std::cout << "C-to-C Ratio: " << c2cRatio << std::endl;
+}
+
+void masterStaticStripsHorizontal(ConfigData* data, float* pixels)
+{
+    //Start the computation time timer.
+    double computationStart = MPI_Wtime();
+
+    //Every process renders one strip of consecutive rows.
+    std::vector<Tile> strips(data->mpi_procs);
+    for (int i = 0; i < data->mpi_procs; i++)
     {
-        for( int column = 0; column < width[0]; column++ )
-        {
+        strips[i].row = stripStart(data->height, data->mpi_procs, i);
+        strips[i].height = stripStart(data->height, data->mpi_procs, i + 1) - strips[i].row;
+        strips[i].column = 0;
+        strips[i].width = data->width;
+    }
+    double communicationTime = renderRegions(data, pixels, strips);
 
-            //Calculate the index into the array.
-            int baseIndex = 3 * ( row * width[0] + column );
+    recordTime(TIME_WAIT, communicationTime);
 
-            //Call the function to shade the pixel.
-            shadePixel(&(pixels[baseIndex]),row,column,data);
-        }
+    //Stop the comp. timer
+    double computationStop = MPI_Wtime();
+    double computationTime = computationStop - computationStart - communicationTime;
+
+    //Print the times and the c-to-c ratio
+    //This section of printing, IN THIS ORDER, needs to be included in all of the
+    //functions that you write at the end of the function.
+    std::cout << "Total Computation Time: " << computationTime << " seconds" << std::endl;
+    std::cout << "Total Communication Time: " << communicationTime << " seconds" << std::endl;
+    double c2cRatio = communicationTime / computationTime;
+    std::cout << "C-to-C Ratio: " << c2cRatio << std::endl;
+}
+
+void masterStaticCyclesHorizontal(ConfigData* data, float* pixels)
+{
+    //Start the computation time timer.
+    double computationStart = MPI_Wtime();
+    double communicationTime = 0.0;
+
+    //Post the receives for the rows of the slaves straight into the image.
+    std::vector<PixelTransfer> transfers(data->mpi_procs - 1);
+    std::vector<MPI_Datatype> types(data->mpi_procs, MPI_DATATYPE_NULL);
+    for (int i = 1; i < data->mpi_procs; i++)
+    {
+        types[i] = rowCyclesType(data, i);
+        startReceivePixels(pixels, 1, types[i], i, 0, &transfers[i - 1]);
     }
 
-    //Receive the data from each process
+    //The master renders its rows straight into the image, and tone maps
+    //them once the luminance of the whole image is known.
+    shadeRowCycles(data, 0, pixels, false);
+    communicationTime += combineLuminance();
+    for (int row = 0; row < data->height; row += data->mpi_procs * data->cycleSize)
+    {
+        toneMapRegion(&(pixels[3 * row * data->width]), data->width,
+            std::min(data->cycleSize, data->height - row), data->width);
+    }
+
+    //Wait for the rows of the slaves.
+    double communicationStart = MPI_Wtime();
+    finishPixels(transfers.empty() ? NULL : &transfers[0], transfers.size());
+    communicationTime += MPI_Wtime() - communicationStart;
+
     for (int i = 1; i < data->mpi_procs; i++)
     {
-        //Receive the width and height of the strip
-        int new_width, new_height;
-        MPI_Recv(&new_width, sizeof(int), MPI_BYTE, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        MPI_Recv(&new_height, sizeof(int), MPI_BYTE, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        width[i] = new_width;
-        height[i] = new_height;
-        //Receive the pixels from each process
-        float stripPixels[3 * width[i] * height[i]];
-        MPI_Recv(stripPixels, 3 * width[i] * height[i], MPI_FLOAT, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-
-        //Consolidate the strips into one image, stored in the master process
-        for(int column = (width[i-1]*i); column < ((width[i-1]*i) + width[i]); column++)
-        {
-            for (int row = 0; row != (data->height); row++)
-            {
-                for(int pix = 0; pix < 3; pix++)
-                {
-                    //Calculate the index into the array.
-                    int baseIndex = 3 * (row * data->width + column) + pix;
-                    int stripBaseIndex = 3 * (row * width[i] + column) + pix;
-                    pixels[baseIndex] = stripPixels[stripBaseIndex];
+        MPI_Type_free(&types[i]);
+    }
 
-                    //std::cout << "stripBaseIndex: " << stripBaseIndex << " pixelsBaseIndex: " << baseIndex << std::endl;
-                }
-            }
-        }
+    recordTime(TIME_WAIT, communicationTime);
+
+    //Stop the comp. timer
+    double computationStop = MPI_Wtime();
+    double computationTime = computationStop - computationStart - communicationTime;
+
+    //Print the times and the c-to-c ratio
+    //This section of printing, IN THIS ORDER, needs to be included in all of the
+    //functions that you write at the end of the function.
+    std::cout << "Total Computation Time: " << computationTime << " seconds" << std::endl;
+    std::cout << "Total Communication Time: " << communicationTime << " seconds" << std::endl;
+    double c2cRatio = communicationTime / computationTime;
+    std::cout << "C-to-C Ratio: " << c2cRatio << std::endl;
+}
+
+void masterStaticCyclesVertical(ConfigData* data, float* pixels)
+{
+    //Start the computation time timer.
+    double computationStart = MPI_Wtime();
+    double communicationTime = 0.0;
+
+    //Post the receives for the columns of the slaves straight into the image.
+    std::vector<PixelTransfer> transfers(data->mpi_procs - 1);
+    std::vector<MPI_Datatype> types(data->mpi_procs, MPI_DATATYPE_NULL);
+    for (int i = 1; i < data->mpi_procs; i++)
+    {
+        types[i] = columnCyclesType(data, i);
+        startReceivePixels(pixels, 1, types[i], i, 0, &transfers[i - 1]);
     }
 
+    //The master renders its columns straight into the image, and tone maps
+    //them once the luminance of the whole image is known.
+    shadeColumnCycles(data, 0, pixels, false);
+    communicationTime += combineLuminance();
+    for (int column = 0; column < data->width; column += data->mpi_procs * data->cycleSize)
+    {
+        toneMapRegion(&(pixels[3 * column]), std::min(data->cycleSize, data->width - column),
+            data->height, data->width);
+    }
+
+    //Wait for the columns of the slaves.
+    double communicationStart = MPI_Wtime();
+    finishPixels(transfers.empty() ? NULL : &transfers[0], transfers.size());
+    communicationTime += MPI_Wtime() - communicationStart;
+
+    for (int i = 1; i < data->mpi_procs; i++)
+    {
+        MPI_Type_free(&types[i]);
+    }
+
+    recordTime(TIME_WAIT, communicationTime);
+
     //Stop the comp. timer
     double computationStop = MPI_Wtime();
-    double computationTime = computationStop - computationStart;
+    double computationTime = computationStop - computationStart - communicationTime;
 
-    //After receiving from all processes, the communication time will
-    //be obtained.
+    //Print the times and the c-to-c ratio
+    //This section of printing, IN THIS ORDER, needs to be included in all of the
+    //functions that you write at the end of the function.
+    std::cout << "Total Computation Time: " << computationTime << " seconds" << std::endl;
+    std::cout << "Total Communication Time: " << communicationTime << " seconds" << std::endl;
+    double c2cRatio = communicationTime / computationTime;
+    std::cout << "C-to-C Ratio: " << c2cRatio << std::endl;
+}
+
+void masterStaticCost(ConfigData* data, float* pixels)
+{
+    //Start the computation time timer.
+    double computationStart = MPI_Wtime();
     double communicationTime = 0.0;
 
+    //Time the prepass and split the image the same way on every process.
+    std::vector<Tile> blocks;
+    std::vector<double> predicted;
+    balancedBlocks(data, &blocks, &predicted);
+
+    //Post the receives for the blocks of the slaves straight into the image.
+    std::vector<PixelTransfer> transfers;
+    std::vector<MPI_Datatype> types;
+    transfers.reserve(data->mpi_procs);
+    for (int i = 1; i < data->mpi_procs; i++)
+    {
+        if (blocks[i].width > 0 && blocks[i].height > 0)
+        {
+            types.push_back(blockType(data, blocks[i]));
+            transfers.push_back(PixelTransfer());
+            startReceivePixels(pixels, 1, types.back(), i, 0, &transfers.back());
+        }
+    }
+
+    //The master renders its block straight into the image.
+    Tile block = blocks[0];
+    double shadeStart = MPI_Wtime();
+    shadeRegion(&(pixels[3 * (block.row * data->width + block.column)]),
+        block.row, block.column, block.width, block.height, data->width, data);
+    double shadeTime = MPI_Wtime() - shadeStart;
+    communicationTime += combineLuminance();
+    toneMapRegion(&(pixels[3 * (block.row * data->width + block.column)]),
+        block.width, block.height, data->width);
+
+    //Wait for the blocks of the slaves and find out how long they took.
+    double communicationStart = MPI_Wtime();
+    finishPixels(transfers.empty() ? NULL : &transfers[0], transfers.size());
+    std::vector<double> actual(data->mpi_procs);
+    MPI_Gather(&shadeTime, 1, MPI_DOUBLE, &actual[0], 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    communicationTime += MPI_Wtime() - communicationStart;
+
+    for (size_t i = 0; i < types.size(); i++)
+    {
+        MPI_Type_free(&types[i]);
+    }
+
+    std::cout << "Predicted vs. Actual Shading Time:" << std::endl;
+    for (int i = 0; i < data->mpi_procs; i++)
+    {
+        std::cout << "    Rank " << i << ": " << blocks[i].width << " x " << blocks[i].height;
+        std::cout << " at (" << blocks[i].column << ", " << blocks[i].row << "), predicted ";
+        std::cout << predicted[i] << " seconds, actual " << actual[i] << " seconds" << std::endl;
+    }
+
+    recordTime(TIME_WAIT, communicationTime);
+
+    //Stop the comp. timer
+    double computationStop = MPI_Wtime();
+    double computationTime = computationStop - computationStart - communicationTime;
+
     //Print the times and the c-to-c ratio
     //This section of printing, IN THIS ORDER, needs to be included in all of the
     //functions that you write at the end of the function.
@@ -0,0 +1,348 @@
+//This file contains the parsing of the command line options that are not
+//handled by the library.
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "RayTrace.h"
+#include "options.h"
+
+RenderOptions renderOptions = { PART_MODE_NONE, 1, NULL, WIRE_FLOAT, NULL, NULL, 16, "/dev/shm", NULL, 1, 0.1f, NULL, NULL, 0.18f, 100.0f, 0.0f, NULL, ORDER_ROWS, 0, NULL };
+
+//True if the wire format was picked with -wire rather than left to the
+//default.
+static bool wireChosen = false;
+
+//The partitioning schemes that are handed to the library in place of the
+//ones it does not know about; they require the same parameters.
+static char dynamicScheme[] = "dynamic";
+static char blocksScheme[] = "static_blocks";
+
+//The partitioning schemes that this program adds to the library's.
+static struct
+{
+    const char* name;
+    PartType mode;
+    char* libraryScheme;
+} extraSchemes[] = {
+    { "work_stealing", PART_MODE_WORK_STEALING, dynamicScheme },
+    { "static_cost", PART_MODE_STATIC_COST, blocksScheme }
+};
+
+static void printUsage()
+{
+    std::cout << "Additional Options:" << std::endl;
+    std::cout << "    -p work_stealing - Work Stealing" << std::endl;
+    std::cout << "           -bh required" << std::endl;
+    std::cout << "           -bw required" << std::endl;
+    std::cout << "    -p static_cost - Static Blocks Balanced By A Timed Prepass" << std::endl;
+    std::cout << "           -sample <n> times one pixel out of every n x n (default 16)" << std::endl;
+    std::cout << "    -t    The number of threads that shade pixels within each process" << std::endl;
+    std::cout << "          Every thread loads its own copy of the scene" << std::endl;
+    std::cout << "    -stream <png|ppm>  Write the rows of the image while rendering" << std::endl;
+    std::cout << "          With dynamic partitioning the master only keeps a window of rows" << std::endl;
+    std::cout << "    -wire <float|half|byte>  The format that pixels are sent to the master in" << std::endl;
+    std::cout << "          byte saves the same image as float; half keeps high dynamic range" << std::endl;
+    std::cout << "    -report <json|csv>  Also print the timing of every process as JSON or CSV" << std::endl;
+    std::cout << "          CSV columns: timing,scheme,procs,threads,width,height,rank,pixels," << std::endl;
+    std::cout << "          shade,wait,copy,total,other" << std::endl;
+    std::cout << "    -heatmap <pixel|tile>  Save the cost of every pixel next to the render" << std::endl;
+    std::cout << "          pixel times every pixel; tile times every region that is shaded" << std::endl;
+    std::cout << "          (a tile, a strip, a block or a cycle) and is almost free" << std::endl;
+    std::cout << "    -stage <dir|off>  Where every node keeps its copy of the scene files" << std::endl;
+    std::cout << "          The master reads the files once and sends them to every node (default /dev/shm)" << std::endl;
+    std::cout << "    -scene-cache <file>  Keep the scene files in one file between runs" << std::endl;
+    std::cout << "          It is written on the first run and rebuilt when a scene file changes" << std::endl;
+    std::cout << "    -aa <k>  Shade k x k samples for the pixels on edges after the first pass" << std::endl;
+    std::cout << "    -aa-threshold <t>  The difference in brightness (0 to 1) that makes an edge (default 0.1)" << std::endl;
+    std::cout << "    -tone <reinhard|ward>  Tone map the image; every process maps its own pixels" << std::endl;
+    std::cout << "    -tone-key <a>  The key that Reinhard's operator maps the average to (default 0.18)" << std::endl;
+    std::cout << "    -tone-display <cd/m2>  The display that Ward's operator maps to (default 100)" << std::endl;
+    std::cout << "    -frames <file>  Render every frame between the camera keyframes in the file" << std::endl;
+    std::cout << "          Each line is: frame eyeX eyeY eyeZ lookAtX lookAtY lookAtZ" << std::endl;
+    std::cout << "          Each PNG is written while the next frame renders; the gather is not overlapped" << std::endl;
+    std::cout << "    -checkpoint <seconds>  Save the shaded pixels to renders/<image>.ckpt this often" << std::endl;
+    std::cout << "    -resume <file>  Only shade the pixels that are not in the checkpoint yet" << std::endl;
+    std::cout << "          Any scheme and number of processes can resume; the file keeps being updated" << std::endl;
+    std::cout << "    -order <rows|morton|hilbert>  The order that tiles and the pixels of a region are shaded in" << std::endl;
+    std::cout << "          morton and hilbert keep neighbouring rays together (default rows)" << std::endl;
+    std::cout << std::endl;
+}
+
+bool parseRenderOptions(int* argc, char** argv[])
+{
+    char** args = *argv;
+    int kept = 1;
+
+    for (int i = 1; i < *argc; i++)
+    {
+        if (strcmp(args[i], "-help") == 0)
+        {
+            printUsage();
+        }
+        else if (strcmp(args[i], "-p") == 0 && i + 1 < *argc)
+        {
+            bool extra = false;
+            for (size_t j = 0; j < sizeof(extraSchemes) / sizeof(extraSchemes[0]); j++)
+            {
+                if (strcmp(args[i + 1], extraSchemes[j].name) == 0)
+                {
+                    renderOptions.partitioningMode = extraSchemes[j].mode;
+                    args[kept++] = args[i++];
+                    args[kept++] = extraSchemes[j].libraryScheme;
+                    extra = true;
+                    break;
+                }
+            }
+            if (extra)
+            {
+                continue;
+            }
+        }
+        else if (strcmp(args[i], "-stage") == 0)
+        {
+            if (i + 1 >= *argc)
+            {
+                std::cerr << "ERROR: -stage <dir|off> requires a directory." << std::endl;
+                return true;
+            }
+            i++;
+            renderOptions.stageDirectory = strcmp(args[i], "off") == 0 ? NULL : args[i];
+            continue;
+        }
+        else if (strcmp(args[i], "-scene-cache") == 0)
+        {
+            if (i + 1 >= *argc)
+            {
+                std::cerr << "ERROR: -scene-cache <file> requires a file." << std::endl;
+                return true;
+            }
+            renderOptions.sceneCache = args[++i];
+            continue;
+        }
+        else if (strcmp(args[i], "-aa") == 0)
+        {
+            if (i + 1 >= *argc || atoi(args[i + 1]) < 1)
+            {
+                std::cerr << "ERROR: -aa <k> must be at least 1." << std::endl;
+                return true;
+            }
+            renderOptions.antialiasing = atoi(args[++i]);
+            continue;
+        }
+        else if (strcmp(args[i], "-aa-threshold") == 0)
+        {
+            if (i + 1 >= *argc || atof(args[i + 1]) < 0.0)
+            {
+                std::cerr << "ERROR: -aa-threshold <t> must not be negative." << std::endl;
+                return true;
+            }
+            renderOptions.antialiasingThreshold = atof(args[++i]);
+            continue;
+        }
+        else if (strcmp(args[i], "-frames") == 0)
+        {
+            if (i + 1 >= *argc)
+            {
+                std::cerr << "ERROR: -frames <file> requires a file." << std::endl;
+                return true;
+            }
+            renderOptions.framesFile = args[++i];
+            continue;
+        }
+        else if (strcmp(args[i], "-checkpoint") == 0)
+        {
+            if (i + 1 >= *argc || atof(args[i + 1]) <= 0.0)
+            {
+                std::cerr << "ERROR: -checkpoint <seconds> must be greater than 0." << std::endl;
+                return true;
+            }
+            renderOptions.checkpointSeconds = atof(args[++i]);
+            continue;
+        }
+        else if (strcmp(args[i], "-resume") == 0)
+        {
+            if (i + 1 >= *argc)
+            {
+                std::cerr << "ERROR: -resume <file> requires a checkpoint." << std::endl;
+                return true;
+            }
+            renderOptions.resumeFile = args[++i];
+            continue;
+        }
+        else if (strcmp(args[i], "-sample") == 0)
+        {
+            if (i + 1 >= *argc || atoi(args[i + 1]) < 1)
+            {
+                std::cerr << "ERROR: -sample <n> must be at least 1." << std::endl;
+                return true;
+            }
+            renderOptions.sampleStep = atoi(args[++i]);
+            continue;
+        }
+        else if (strcmp(args[i], "-t") == 0)
+        {
+            if (i + 1 >= *argc || atoi(args[i + 1]) < 1)
+            {
+                std::cerr << "ERROR: -t <threads> must be at least 1." << std::endl;
+                return true;
+            }
+            renderOptions.threads = atoi(args[++i]);
+            continue;
+        }
+        else if (strcmp(args[i], "-stream") == 0)
+        {
+            if (i + 1 >= *argc || (strcmp(args[i + 1], "png") != 0 && strcmp(args[i + 1], "ppm") != 0))
+            {
+                std::cerr << "ERROR: -stream <format> must be png or ppm." << std::endl;
+                return true;
+            }
+            renderOptions.streamFormat = args[++i];
+            continue;
+        }
+        else if (strcmp(args[i], "-wire") == 0)
+        {
+            const char* format = i + 1 < *argc ? args[i + 1] : "";
+            if (strcmp(format, "float") == 0)
+            {
+                renderOptions.wireFormat = WIRE_FLOAT;
+            }
+            else if (strcmp(format, "half") == 0)
+            {
+                renderOptions.wireFormat = WIRE_HALF;
+            }
+            else if (strcmp(format, "byte") == 0)
+            {
+                renderOptions.wireFormat = WIRE_BYTE;
+            }
+            else
+            {
+                std::cerr << "ERROR: -wire <format> must be float, half or byte." << std::endl;
+                return true;
+            }
+            wireChosen = true;
+            i++;
+            continue;
+        }
+        else if (strcmp(args[i], "-order") == 0)
+        {
+            const char* order = i + 1 < *argc ? args[i + 1] : "";
+            if (strcmp(order, "rows") == 0)
+            {
+                renderOptions.tileOrder = ORDER_ROWS;
+            }
+            else if (strcmp(order, "morton") == 0)
+            {
+                renderOptions.tileOrder = ORDER_MORTON;
+            }
+            else if (strcmp(order, "hilbert") == 0)
+            {
+                renderOptions.tileOrder = ORDER_HILBERT;
+            }
+            else
+            {
+                std::cerr << "ERROR: -order <order> must be rows, morton or hilbert." << std::endl;
+                return true;
+            }
+            i++;
+            continue;
+        }
+        else if (strcmp(args[i], "-report") == 0)
+        {
+            if (i + 1 >= *argc || (strcmp(args[i + 1], "json") != 0 && strcmp(args[i + 1], "csv") != 0))
+            {
+                std::cerr << "ERROR: -report <format> must be json or csv." << std::endl;
+                return true;
+            }
+            renderOptions.reportFormat = args[++i];
+            continue;
+        }
+        else if (strcmp(args[i], "-heatmap") == 0)
+        {
+            if (i + 1 >= *argc || (strcmp(args[i + 1], "pixel") != 0 && strcmp(args[i + 1], "tile") != 0))
+            {
+                std::cerr << "ERROR: -heatmap <granularity> must be pixel or tile." << std::endl;
+                return true;
+            }
+            renderOptions.heatmapMode = args[++i];
+            continue;
+        }
+        else if (strcmp(args[i], "-tone") == 0)
+        {
+            if (i + 1 >= *argc || (strcmp(args[i + 1], "reinhard") != 0 && strcmp(args[i + 1], "ward") != 0))
+            {
+                std::cerr << "ERROR: -tone <operator> must be reinhard or ward." << std::endl;
+                return true;
+            }
+            renderOptions.toneOperator = args[++i];
+            continue;
+        }
+        else if (strcmp(args[i], "-tone-key") == 0)
+        {
+            if (i + 1 >= *argc || atof(args[i + 1]) <= 0.0)
+            {
+                std::cerr << "ERROR: -tone-key <a> must be greater than 0." << std::endl;
+                return true;
+            }
+            renderOptions.toneKey = atof(args[++i]);
+            continue;
+        }
+        else if (strcmp(args[i], "-tone-display") == 0)
+        {
+            if (i + 1 >= *argc || atof(args[i + 1]) <= 0.0)
+            {
+                std::cerr << "ERROR: -tone-display <cd/m2> must be greater than 0." << std::endl;
+                return true;
+            }
+            renderOptions.toneDisplay = atof(args[++i]);
+            continue;
+        }
+        args[kept++] = args[i];
+    }
+
+    *argc = kept;
+    args[kept] = NULL;
+
+    //A checkpoint holds the pixels of one image.
+    if (renderOptions.framesFile != NULL &&
+        (renderOptions.checkpointSeconds > 0.0f || renderOptions.resumeFile != NULL))
+    {
+        std::cerr << "ERROR: -checkpoint and -resume cannot be used with -frames." << std::endl;
+        return true;
+    }
+
+    //Keep a copy of the arguments for loading the scene again.
+    renderOptions.sceneArgc = kept;
+    renderOptions.sceneArgv = new char*[kept + 1];
+    for (int i = 0; i <= kept; i++)
+    {
+        renderOptions.sceneArgv[i] = args[i];
+    }
+    return false;
+}
+
+void applyRenderOptions(ConfigData* data)
+{
+    if (renderOptions.partitioningMode != PART_MODE_NONE)
+    {
+        data->partitioningMode = renderOptions.partitioningMode;
+    }
+
+    //Tone mapped pixels are ready to be saved, so they are sent in 8 bits
+    //unless asked otherwise. The dynamic scheme sends the pixels before
+    //they are tone mapped, so it needs the range of floats.
+    if (renderOptions.toneOperator != NULL && data->partitioningMode != PART_MODE_DYNAMIC && !wireChosen)
+    {
+        renderOptions.wireFormat = WIRE_BYTE;
+    }
+    else if (renderOptions.toneOperator != NULL && data->partitioningMode == PART_MODE_DYNAMIC &&
+        renderOptions.wireFormat == WIRE_BYTE)
+    {
+        if (data->mpi_rank == 0)
+        {
+            std::cerr << "-wire byte would clip the pixels before they are tone mapped; sending floats." << std::endl;
+        }
+        renderOptions.wireFormat = WIRE_FLOAT;
+    }
+}
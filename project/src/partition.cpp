@@ -0,0 +1,163 @@
+//This file contains the helpers used to split the image between the
+//processes for the static partitioning schemes.
+
+#include <algorithm>
+#include <vector>
+#include <mpi.h>
+
+#include "RayTrace.h"
+#include "partition.h"
+#include "threads.h"
+#include "tone.h"
+
+//The number of bands that a region is sent to the master in. More bands
+//hide more of the transfer behind the shading, but every one is another
+//message and another receive that the master has to post.
+#define REGION_BANDS 16
+
+int stripStart(int lines, int procs, int rank)
+{
+    return (int)((long long)lines * rank / procs);
+}
+
+int cycleLines(int lines, int cycleSize, int procs, int rank)
+{
+    int count = 0;
+    for (int start = rank * cycleSize; start < lines; start += procs * cycleSize)
+    {
+        count += std::min(cycleSize, lines - start);
+    }
+    return count;
+}
+
+Tile blockAt(ConfigData* data, int rank)
+{
+    //dims[0] is the number of rows of blocks and dims[1] the number of columns.
+    int dims[2] = { 0, 0 };
+    MPI_Dims_create(data->mpi_procs, 2, dims);
+    int gridRow = rank / dims[1];
+    int gridColumn = rank % dims[1];
+
+    Tile block;
+    block.row = stripStart(data->height, dims[0], gridRow);
+    block.height = stripStart(data->height, dims[0], gridRow + 1) - block.row;
+    block.column = stripStart(data->width, dims[1], gridColumn);
+    block.width = stripStart(data->width, dims[1], gridColumn + 1) - block.column;
+    return block;
+}
+
+int bandRows(int rows)
+{
+    if (toneMapping())
+    {
+        return std::max(rows, 1);
+    }
+    return std::max((rows + REGION_BANDS - 1) / REGION_BANDS, 1);
+}
+
+void shadeRowCycles(ConfigData* data, int rank, float* buffer, bool pack)
+{
+    int cycleSize = data->cycleSize;
+    for (int start = rank * cycleSize; start < data->height; start += data->mpi_procs * cycleSize)
+    {
+        int rows = std::min(cycleSize, data->height - start);
+        float* cycle = pack ? buffer : &(buffer[3 * start * data->width]);
+        shadeRegion(cycle, start, 0, data->width, rows, data->width, data);
+        buffer += pack ? 3 * rows * data->width : 0;
+    }
+}
+
+void shadeColumnCycles(ConfigData* data, int rank, float* buffer, bool pack)
+{
+    int cycleSize = data->cycleSize;
+    int stride = pack ? cycleLines(data->width, cycleSize, data->mpi_procs, rank) : data->width;
+    for (int start = rank * cycleSize; start < data->width; start += data->mpi_procs * cycleSize)
+    {
+        int columns = std::min(cycleSize, data->width - start);
+        float* cycle = pack ? buffer : &(buffer[3 * start]);
+        shadeRegion(cycle, 0, start, columns, data->height, stride, data);
+        buffer += pack ? 3 * columns : 0;
+    }
+}
+
+MPI_Datatype columnType(int height, int stride)
+{
+    MPI_Datatype column, type;
+    MPI_Type_vector(height, 3, 3 * stride, MPI_FLOAT, &column);
+    MPI_Type_create_resized(column, 0, 3 * sizeof(float), &type);
+    MPI_Type_free(&column);
+    MPI_Type_commit(&type);
+    return type;
+}
+
+MPI_Datatype blockType(ConfigData* data, Tile block)
+{
+    int sizes[2] = { data->height, 3 * data->width };
+    int subsizes[2] = { block.height, 3 * block.width };
+    int starts[2] = { block.row, 3 * block.column };
+
+    MPI_Datatype type;
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_FLOAT, &type);
+    MPI_Type_commit(&type);
+    return type;
+}
+
+MPI_Datatype tilesType(ConfigData* data, const int* tiles, int count)
+{
+    //Every row of every tile is one contiguous run of floats in the image.
+    std::vector<int> lengths, displacements;
+    for (int i = 0; i < count; i++)
+    {
+        Tile tile = tileAt(data, data->dynamicBlockWidth, data->dynamicBlockHeight, tiles[i]);
+        for (int row = tile.row; row < tile.row + tile.height; row++)
+        {
+            lengths.push_back(3 * tile.width);
+            displacements.push_back(3 * (row * data->width + tile.column));
+        }
+    }
+
+    MPI_Datatype type;
+    MPI_Type_indexed(lengths.size(), lengths.empty() ? NULL : &lengths[0],
+        displacements.empty() ? NULL : &displacements[0], MPI_FLOAT, &type);
+    MPI_Type_commit(&type);
+    return type;
+}
+
+MPI_Datatype rowCyclesType(ConfigData* data, int rank)
+{
+    //Every cycle of rows is one contiguous run of floats in the image.
+    std::vector<int> lengths, displacements;
+    int cycleSize = data->cycleSize;
+    for (int start = rank * cycleSize; start < data->height; start += data->mpi_procs * cycleSize)
+    {
+        int rows = std::min(cycleSize, data->height - start);
+        lengths.push_back(3 * rows * data->width);
+        displacements.push_back(3 * start * data->width);
+    }
+
+    MPI_Datatype type;
+    MPI_Type_indexed(lengths.size(), lengths.empty() ? NULL : &lengths[0],
+        displacements.empty() ? NULL : &displacements[0], MPI_FLOAT, &type);
+    MPI_Type_commit(&type);
+    return type;
+}
+
+MPI_Datatype columnCyclesType(ConfigData* data, int rank)
+{
+    //Every cycle is a run of neighbouring columns of the image.
+    std::vector<int> lengths, displacements;
+    int cycleSize = data->cycleSize;
+    for (int start = rank * cycleSize; start < data->width; start += data->mpi_procs * cycleSize)
+    {
+        lengths.push_back(std::min(cycleSize, data->width - start));
+        displacements.push_back(start);
+    }
+
+    MPI_Datatype column = columnType(data->height, data->width);
+    MPI_Datatype type;
+    MPI_Type_indexed(lengths.size(), lengths.empty() ? NULL : &lengths[0],
+        displacements.empty() ? NULL : &displacements[0], column, &type);
+    MPI_Type_free(&column);
+    MPI_Type_commit(&type);
+    return type;
+}
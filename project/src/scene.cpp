@@ -0,0 +1,508 @@
+//This file contains the code that shares the scene files between the
+//processes.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <mpi.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "options.h"
+#include "scene.h"
+
+//The processes on this node, and the files and directories that this
+//process wrote for them.
+static MPI_Comm node = MPI_COMM_NULL;
+static std::vector<std::string> stagedFiles;
+static std::vector<std::string> stagedDirectories;
+
+//Reads a whole file. Returns false if it could not be read.
+static bool readFile(const std::string& path, std::string* contents)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+    std::ostringstream stream;
+    stream << file.rdbuf();
+    *contents = stream.str();
+    return true;
+}
+
+//Returns the directory part of a path, including the final slash.
+static std::string directoryOf(const std::string& path)
+{
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+//Adds a file to the bundle that is broadcast to the nodes.
+static void addFile(std::string* bundle, const std::string& name, const std::string& contents)
+{
+    unsigned long long sizes[2] = { name.size(), contents.size() };
+    bundle->append((const char*)sizes, sizeof(sizes));
+    bundle->append(name);
+    bundle->append(contents);
+}
+
+//Stands in for the staging directory in the bundled configuration file,
+//since the directory is different for every run.
+#define STAGE_DIRECTORY "@STAGE@"
+
+//Reads the configuration file and every model and material file that it
+//names into a bundle. The <Path> of every model that could be read is
+//changed to point at its staged copy. The paths of the files that were
+//read are added to sources.
+static void bundleScene(const std::string& config, std::string* bundle, std::vector<std::string>* sources)
+{
+    std::string xml;
+    if (!readFile(config, &xml))
+    {
+        return;
+    }
+    sources->push_back(config);
+
+    size_t position = 0;
+    int model = 0;
+    while ((position = xml.find("<Path>", position)) != std::string::npos)
+    {
+        size_t start = position + strlen("<Path>");
+        size_t end = xml.find("</Path>", start);
+        if (end == std::string::npos)
+        {
+            break;
+        }
+
+        //Models that cannot be read keep their path, so that initialize()
+        //reports them just like before.
+        std::string path = xml.substr(start, end - start);
+        std::string obj;
+        position = end;
+        if (!readFile(path, &obj))
+        {
+            continue;
+        }
+
+        //Materials are found next to the model.
+        std::ostringstream staged;
+        staged << model++ << "/";
+        std::string name = path.substr(path.find_last_of('/') + 1);
+        addFile(bundle, staged.str() + name, obj);
+        sources->push_back(path);
+        std::istringstream lines(obj);
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            std::istringstream words(line);
+            std::string word, material, contents;
+            if (words >> word && word == "mtllib" && words >> material &&
+                readFile(directoryOf(path) + material, &contents))
+            {
+                addFile(bundle, staged.str() + material, contents);
+                sources->push_back(directoryOf(path) + material);
+            }
+        }
+
+        std::string stagedPath = STAGE_DIRECTORY "/" + staged.str() + name;
+        xml.replace(start, end - start, stagedPath);
+        position = start + stagedPath.size();
+    }
+    addFile(bundle, "scene.xml", xml);
+}
+
+//Creates every directory above the given file. Returns false on failure.
+static bool makeDirectories(const std::string& file)
+{
+    for (size_t slash = file.find('/', 1); slash != std::string::npos; slash = file.find('/', slash + 1))
+    {
+        std::string directory = file.substr(0, slash);
+        if (mkdir(directory.c_str(), 0700) == 0)
+        {
+            stagedDirectories.push_back(directory);
+        }
+        else if (errno != EEXIST)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//Checks that every file of the bundle lies inside it and that its name
+//stays inside the staging directory. Returns false if the bundle is damaged.
+static bool checkBundle(const char* bundle, unsigned long long size)
+{
+    unsigned long long position = 0;
+    while (position < size)
+    {
+        unsigned long long sizes[2];
+        if (size - position < sizeof(sizes))
+        {
+            return false;
+        }
+        memcpy(sizes, &bundle[position], sizeof(sizes));
+        position += sizeof(sizes);
+        if (sizes[0] > size - position || sizes[1] > size - position - sizes[0])
+        {
+            return false;
+        }
+
+        //The name must be relative and must not climb out of the directory.
+        std::string relative(&bundle[position], sizes[0]);
+        std::string parts = "/" + relative + "/";
+        if (relative.empty() || relative[0] == '/' || relative.find('\0') != std::string::npos ||
+            parts.find("/../") != std::string::npos)
+        {
+            return false;
+        }
+        position += sizes[0] + sizes[1];
+    }
+    return true;
+}
+
+//Writes the files of the bundle into the directory. Returns false on failure.
+static bool writeBundle(const std::string& directory, const char* bundle, unsigned long long size)
+{
+    if (!checkBundle(bundle, size))
+    {
+        return false;
+    }
+
+    unsigned long long position = 0;
+    while (position < size)
+    {
+        unsigned long long sizes[2];
+        memcpy(sizes, &bundle[position], sizeof(sizes));
+        position += sizeof(sizes);
+        std::string relative(&bundle[position], sizes[0]);
+        std::string name = directory + "/" + relative;
+        position += sizes[0];
+
+        //Point the configuration file at this directory.
+        std::string contents;
+        const char* bytes = &bundle[position];
+        if (relative == "scene.xml")
+        {
+            contents.assign(bytes, sizes[1]);
+            size_t at = 0;
+            while ((at = contents.find(STAGE_DIRECTORY, at)) != std::string::npos)
+            {
+                contents.replace(at, strlen(STAGE_DIRECTORY), directory);
+                at += directory.size();
+            }
+            bytes = contents.data();
+        }
+        unsigned long long length = relative == "scene.xml" ? contents.size() : sizes[1];
+
+        if (!makeDirectories(name))
+        {
+            return false;
+        }
+        FILE* file = fopen(name.c_str(), "wb");
+        if (file == NULL)
+        {
+            return false;
+        }
+        stagedFiles.push_back(name);
+        bool written = fwrite(bytes, 1, length, file) == length;
+        written = fclose(file) == 0 && written;
+        if (!written)
+        {
+            return false;
+        }
+        position += sizes[1];
+    }
+    return true;
+}
+
+//Broadcasts bytes from rank 0 of the communicator, in pieces that fit in
+//an int. Rank 0 passes the bytes in data and size; the other processes
+//receive them into storage, which data is then pointed at.
+static void broadcastBytes(const char** data, unsigned long long* size, std::string* storage, MPI_Comm comm)
+{
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Bcast(size, 1, MPI_UNSIGNED_LONG_LONG, 0, comm);
+    if (rank != 0)
+    {
+        storage->resize(*size);
+        *data = storage->data();
+    }
+    for (unsigned long long offset = 0; offset < *size; offset += INT_MAX)
+    {
+        int count = (int)std::min<unsigned long long>(INT_MAX, *size - offset);
+        MPI_Bcast((void*)&((*data)[offset]), count, MPI_BYTE, 0, comm);
+    }
+}
+
+//Broadcasts a string from rank 0 of the communicator.
+static void broadcastString(std::string* value, MPI_Comm comm)
+{
+    const char* data = value->data();
+    unsigned long long size = value->size();
+    broadcastBytes(&data, &size, value, comm);
+}
+
+//The layout of a scene cache file:
+//    char magic[8] = CACHE_MAGIC
+//    unsigned long long version = CACHE_VERSION
+//    unsigned long long sources
+//    for each source file: unsigned long long size, long long mtime,
+//        unsigned long long pathLength, char path[pathLength]
+//    unsigned long long bundleSize
+//    char bundle[bundleSize]
+//Nothing in it depends on where it is mapped or where the scene is staged.
+#define CACHE_MAGIC "RTSCENE\0"
+#define CACHE_VERSION 1ULL
+
+//A scene cache file that is mapped into memory.
+typedef struct
+{
+    void* map;
+    size_t length;
+    const char* bundle;
+    unsigned long long bundleSize;
+} SceneCache;
+
+//Reads a value from the cache, checking that it is inside the file.
+static bool readCache(const SceneCache& cache, size_t* position, void* value, size_t size)
+{
+    if (*position + size > cache.length)
+    {
+        return false;
+    }
+    memcpy(value, (const char*)cache.map + *position, size);
+    *position += size;
+    return true;
+}
+
+//Maps the cache file and checks that it was built from the given
+//configuration file and that none of its source files have changed since.
+//Returns false if the cache cannot be used.
+static bool openCache(const char* path, const std::string& config, SceneCache* cache)
+{
+    int file = open(path, O_RDONLY);
+    struct stat info;
+    if (file < 0 || fstat(file, &info) != 0 || info.st_size == 0)
+    {
+        if (file >= 0)
+        {
+            close(file);
+        }
+        return false;
+    }
+    cache->length = info.st_size;
+    cache->map = mmap(NULL, cache->length, PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+    if (cache->map == MAP_FAILED)
+    {
+        return false;
+    }
+
+    size_t position = 0;
+    char magic[8];
+    unsigned long long version, sources;
+    bool valid = readCache(*cache, &position, magic, sizeof(magic)) &&
+        memcmp(magic, CACHE_MAGIC, sizeof(magic)) == 0 &&
+        readCache(*cache, &position, &version, sizeof(version)) && version == CACHE_VERSION &&
+        readCache(*cache, &position, &sources, sizeof(sources));
+    for (unsigned long long i = 0; valid && i < sources; i++)
+    {
+        unsigned long long size, length;
+        long long mtime;
+        valid = readCache(*cache, &position, &size, sizeof(size)) &&
+            readCache(*cache, &position, &mtime, sizeof(mtime)) &&
+            readCache(*cache, &position, &length, sizeof(length)) &&
+            position + length <= cache->length;
+        if (!valid)
+        {
+            break;
+        }
+        std::string source((const char*)cache->map + position, length);
+        position += length;
+
+        //The first source is the configuration file itself.
+        struct stat current;
+        valid = (i > 0 || source == config) && stat(source.c_str(), &current) == 0 &&
+            (unsigned long long)current.st_size == size && (long long)current.st_mtime == mtime;
+    }
+    valid = valid && readCache(*cache, &position, &cache->bundleSize, sizeof(cache->bundleSize)) &&
+        position + cache->bundleSize == cache->length &&
+        checkBundle((const char*)cache->map + position, cache->bundleSize);
+    if (!valid)
+    {
+        munmap(cache->map, cache->length);
+        return false;
+    }
+    cache->bundle = (const char*)cache->map + position;
+    return true;
+}
+
+//Writes a new cache file for the bundle. The file is written next to its
+//final name and then renamed, so that a run that reads it at the same time
+//never sees half of it.
+static void writeCache(const char* path, const std::string& bundle, const std::vector<std::string>& sources)
+{
+    std::string cache(CACHE_MAGIC, 8);
+    unsigned long long header[2] = { CACHE_VERSION, sources.size() };
+    cache.append((const char*)header, sizeof(header));
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        struct stat info;
+        if (stat(sources[i].c_str(), &info) != 0)
+        {
+            return;
+        }
+        unsigned long long size = info.st_size, length = sources[i].size();
+        long long mtime = info.st_mtime;
+        cache.append((const char*)&size, sizeof(size));
+        cache.append((const char*)&mtime, sizeof(mtime));
+        cache.append((const char*)&length, sizeof(length));
+        cache.append(sources[i]);
+    }
+    unsigned long long bundleSize = bundle.size();
+    cache.append((const char*)&bundleSize, sizeof(bundleSize));
+    cache.append(bundle);
+
+    std::string temporary = std::string(path) + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "wb");
+    bool written = file != NULL && fwrite(cache.data(), 1, cache.size(), file) == cache.size();
+    written = file != NULL && fclose(file) == 0 && written;
+    if (!written || rename(temporary.c_str(), path) != 0)
+    {
+        std::cerr << "Could not write the scene cache at: " << path << std::endl;
+        unlink(temporary.c_str());
+    }
+}
+
+void stageScene(int argc, char** argv)
+{
+    int rank, procs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &procs);
+    if ((procs < 2 && renderOptions.sceneCache == NULL) || renderOptions.stageDirectory == NULL)
+    {
+        return;
+    }
+
+    int config = 0;
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (strcmp(argv[i], "-c") == 0)
+        {
+            config = i + 1;
+        }
+    }
+    if (config == 0)
+    {
+        return;
+    }
+
+    //One process per node receives the scene and writes it to disk for
+    //the others. The master is the first process of its node.
+    MPI_Comm leaders;
+    int nodeRank;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node);
+    MPI_Comm_rank(node, &nodeRank);
+    MPI_Comm_split(MPI_COMM_WORLD, nodeRank == 0 ? 0 : MPI_UNDEFINED, rank, &leaders);
+
+    //The name of the directory comes from the master, so that it is the
+    //same on every node and different for every run.
+    //The master takes the bundle straight from the cache when it can.
+    std::string directory, bundle;
+    const char* bundleData = NULL;
+    unsigned long long bundleSize = 0;
+    SceneCache cache;
+    cache.map = NULL;
+    if (rank == 0)
+    {
+        std::ostringstream name;
+        name << renderOptions.stageDirectory << "/raytrace-" << getpid() << "-" << time(NULL);
+        directory = name.str();
+        if (renderOptions.sceneCache != NULL && openCache(renderOptions.sceneCache, argv[config], &cache))
+        {
+            bundleData = cache.bundle;
+            bundleSize = cache.bundleSize;
+        }
+        else
+        {
+            cache.map = NULL;
+            std::vector<std::string> sources;
+            bundleScene(argv[config], &bundle, &sources);
+            if (renderOptions.sceneCache != NULL && !bundle.empty())
+            {
+                writeCache(renderOptions.sceneCache, bundle, sources);
+            }
+            bundleData = bundle.data();
+            bundleSize = bundle.size();
+        }
+    }
+
+    int staged = 0;
+    if (leaders != MPI_COMM_NULL)
+    {
+        broadcastString(&directory, leaders);
+        broadcastBytes(&bundleData, &bundleSize, &bundle, leaders);
+        MPI_Comm_free(&leaders);
+        if (bundleSize > 0)
+        {
+            staged = writeBundle(directory, bundleData, bundleSize);
+            if (!staged)
+            {
+                std::cerr << "Could not stage the scene in " << directory;
+                std::cerr << "; loading it from where it is." << std::endl;
+            }
+        }
+    }
+    if (cache.map != NULL)
+    {
+        munmap(cache.map, cache.length);
+    }
+    MPI_Bcast(&staged, 1, MPI_INT, 0, node);
+    broadcastString(&directory, node);
+    if (!staged)
+    {
+        return;
+    }
+
+    //Load the scene from the staged copy, including the extra copies that
+    //the threads load.
+    static std::string stagedConfig;
+    stagedConfig = directory + "/scene.xml";
+    argv[config] = (char*)stagedConfig.c_str();
+    renderOptions.sceneArgv[config] = argv[config];
+}
+
+void unstageScene()
+{
+    if (node == MPI_COMM_NULL)
+    {
+        return;
+    }
+
+    //Wait until every process on the node has loaded the scene.
+    MPI_Barrier(node);
+    MPI_Comm_free(&node);
+    for (size_t i = 0; i < stagedFiles.size(); i++)
+    {
+        unlink(stagedFiles[i].c_str());
+    }
+    for (size_t i = stagedDirectories.size(); i > 0; i--)
+    {
+        rmdir(stagedDirectories[i - 1].c_str());
+    }
+    stagedFiles.clear();
+    stagedDirectories.clear();
+}
@@ -0,0 +1,21 @@
+//This file contains the code that shades runs of pixels.
+
+#include "RayTrace.h"
+#include "shade.h"
+
+void shadeSpan(float* out, int row, int firstColumn, int width, ConfigData* data)
+{
+    for (int column = 0; column < width; column++)
+    {
+        shadePixel(&(out[3 * column]), row, firstColumn + column, data);
+    }
+}
+
+void shadeTile(float* out, int firstRow, int firstColumn, int width, int height,
+    int outStride, ConfigData* data)
+{
+    for (int row = 0; row < height; row++)
+    {
+        shadeSpan(&(out[3 * row * outStride]), firstRow + row, firstColumn, width, data);
+    }
+}
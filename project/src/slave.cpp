@@ -1,115 +1,360 @@
 //This file contains the code that the master process will execute.
 
+#include <algorithm>
+#include <deque>
 #include <iostream>
+#include <vector>
 #include <mpi.h>
 #include <unistd.h>
 #include "RayTrace.h"
+#include "antialias.h"
+#include "balance.h"
+#include "heatmap.h"
+#include "options.h"
+#include "partition.h"
 #include "slave.h"
+#include "stealing.h"
+#include "threads.h"
+#include "tiles.h"
+#include "timing.h"
+#include "tone.h"
+#include "wire.h"
 
 void slaveMain(ConfigData* data)
 {
     //Print PID (for debugging)
     std::cout << "Slave " << data->mpi_rank << " PID: " << getpid() << std::endl;
+    double startTime = MPI_Wtime();
     //Depending on the partitioning scheme, different things will happen.
     //You should have a different function for each of the required 
     //schemes that returns some values that you need to handle.
-    switch (data->partitioningMode)
+    switch ((int)data->partitioningMode)
     {
+        case PART_MODE_STATIC_STRIPS_HORIZONTAL:
+            slaveStaticStripsHorizontal(data);
+            break;
         case PART_MODE_STATIC_STRIPS_VERTICAL:
             slaveStaticStripsVertical(data);
             break;
+        case PART_MODE_STATIC_CYCLES_HORIZONTAL:
+            slaveStaticCyclesHorizontal(data);
+            break;
+        case PART_MODE_STATIC_CYCLES_VERTICAL:
+            slaveStaticCyclesVertical(data);
+            break;
         case PART_MODE_STATIC_BLOCKS:
             slaveStaticBlocks(data);
             break;
+        case PART_MODE_DYNAMIC:
+            slaveDynamic(data);
+            break;
+        case PART_MODE_WORK_STEALING:
+            slaveWorkStealing(data);
+            break;
+        case PART_MODE_STATIC_COST:
+            slaveStaticCost(data);
+            break;
         case PART_MODE_NONE:
-            //The slave will do nothing since this means sequential operation.
+            //The slave will do nothing since this means sequential operation,
+            //other than to add its share of nothing to the luminance.
+            recordTime(TIME_WAIT, combineLuminance());
             break;
         default:
             std::cout << "This mode (" << data->partitioningMode;
             std::cout << ") is not currently implemented." << std::endl;
             break;
     }
+
+    refineEdges(data, NULL);
+
+    recordTime(TIME_TOTAL, MPI_Wtime() - startTime);
+    finishHeatmap(data, "");
 }
 
-void slaveStaticStripsVertical(ConfigData* data)
+//Renders a region of the image and sends it to the master in bands of
+//bandRows() rows. The bands are shaded into two buffers in turn, so that
+//one band is sent while the next one is shaded.
+static void sendRegion(ConfigData* data, Tile region)
 {
-    //Receive the data from the master process
-    int width = 0;
-    int height = 0;
-    //Receive the width and height of the strip from the master process
-    MPI_Recv(&width, sizeof(int), MPI_BYTE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-    MPI_Recv(&height, sizeof(int), MPI_BYTE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-    int offset = 0;
-    MPI_Recv(&offset, sizeof(int), MPI_BYTE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-    std::cout << "Slave " << data->mpi_rank << " offset " << offset << std::endl;
-    //Allocate space for the image on the slave
-    //float pixels[data->width * data->height];
-    float* pixels = new float[3 * width * height];
-    //Receive the pixels from the master process
-    //MPI_Recv(pixels, 3 * width * height, MPI_FLOAT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-    std::cout << "Slave " << data->mpi_rank << " received strip of size " << width << " x " << height << std::endl;
-    std::cout << "Width: " << width << std::endl;
-    std::cout << "Height: " << height << std::endl;
-    //Render the scene
-    for( int row = 0; row < height; row++ )
+    int rows = bandRows(region.height);
+    std::vector<float> buffers[2];
+    PixelTransfer transfers[2];
+    for (int i = 0; i < 2; i++)
     {
-        for( int column = 0; column < width; column++ )
-        {
+        transfers[i].request = MPI_REQUEST_NULL;
+        transfers[i].receiving = false;
+    }
+    double communicationTime = 0.0;
 
-            //Calculate the index into the array.
-            int baseIndex = 3 * ( row * width + column );
-            if(row > height - 2)
-            {
-                std::cout << "Slave " << data->mpi_rank << " rendering row " << row << " column " << column << std::endl;
-                std::cout << "Base index: " << baseIndex << std::endl;
-                std::cout << "Width: " << width << std::endl;
-            }
-            //Call the function to shade the pixel.
-            shadePixel(&(pixels[baseIndex]),row,column + offset,data);
+    for (int row = 0, band = 0; row < region.height; row += rows, band++)
+    {
+        int height = std::min(rows, region.height - row);
+        std::vector<float>& pixels = buffers[band % 2];
+        PixelTransfer* transfer = &transfers[band % 2];
+
+        //Wait for the band that was sent from this buffer before reusing it.
+        double communicationStart = MPI_Wtime();
+        finishPixels(transfer, 1);
+        communicationTime += MPI_Wtime() - communicationStart;
+
+        pixels.resize(3 * region.width * height);
+        shadeRegion(&pixels[0], region.row + row, region.column, region.width, height,
+            region.width, data);
+        if (toneMapping())
+        {
+            //The region is a single band, which is tone mapped once the
+            //luminance of the whole image is known.
+            communicationTime += combineLuminance();
+            toneMapRegion(&pixels[0], region.width, height, region.width);
         }
+        startSendPixels(&pixels[0], 3 * region.width * height, MPI_FLOAT, 0, 0, transfer);
+    }
+    if (region.height == 0)
+    {
+        //Add this process's share of nothing to the luminance.
+        communicationTime += combineLuminance();
     }
 
-    //Send the width and height of the strip back to the master process
-    MPI_Send(&width, sizeof(int), MPI_BYTE, 0, 0, MPI_COMM_WORLD);
-    MPI_Send(&height, sizeof(int), MPI_BYTE, 0, 0, MPI_COMM_WORLD);
-    
-    //Send the pixels back to the master process
-    MPI_Send(pixels, 3 * width * height, MPI_FLOAT, 0, 0, MPI_COMM_WORLD);
-    std::cout << "Slave " << data->mpi_rank << " sent strip back to master" << std::endl;
+    double communicationStart = MPI_Wtime();
+    finishPixels(transfers, 2);
+    communicationTime += MPI_Wtime() - communicationStart;
+    recordTime(TIME_WAIT, communicationTime);
+}
+
+void slaveStaticStripsVertical(ConfigData* data)
+{
+    //Work out which columns belong to this process.
+    Tile strip;
+    strip.row = 0;
+    strip.height = data->height;
+    strip.column = stripStart(data->width, data->mpi_procs, data->mpi_rank);
+    strip.width = stripStart(data->width, data->mpi_procs, data->mpi_rank + 1) - strip.column;
+
+    //Render the strip and send it back to the master process.
+    sendRegion(data, strip);
 }
 
 void slaveStaticBlocks(ConfigData* data)
 {
-    //Receive the data from the master process
-    ConfigData blockData;
-    MPI_Recv(&blockData, sizeof(ConfigData), MPI_BYTE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-    //Allocate space for the image on the slave
-    float pixels[3 * blockData.width * blockData.height];
-    //Receive the pixels from the master process
-    MPI_Recv(pixels, 3 * blockData.width * blockData.height, MPI_FLOAT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-    std::cout << "Slave " << data->mpi_rank << " received block of size " << blockData.width << " x " << blockData.height << std::endl;
-    //Render the scene
-    for( int i = 0; i < blockData.height; ++i )
+    //Work out which block belongs to this process, then render it and send
+    //it back to the master process.
+    sendRegion(data, blockAt(data, data->mpi_rank));
+}
+
+//Takes in one message from the master. A tile, or TILE_NONE, is added to
+//the tiles waiting to be shaded. A cancel marks the tile to be dropped,
+//and if this slave already shaded it, another slave returned it first, so
+//its cost is taken out of the heatmap.
+static void receiveAssign(ConfigData* data, std::deque<int>* pending,
+    std::vector<char>* cancelled, const std::vector<char>& shaded)
+{
+    int index;
+    MPI_Recv(&index, 1, MPI_INT, 0, TAG_TILE_ASSIGN, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    if (index >= TILE_NONE)
     {
-        //std::cout << "Slave " << data->mpi_rank << " rendering row " << i << std::endl;
-        for( int j = 0; j < blockData.width; ++j )
-        {
-            int row = i;
-            int column = j;
+        pending->push_back(index);
+        return;
+    }
+    index = TILE_CANCEL(index);
+    (*cancelled)[index] = 1;
+    if (shaded[index])
+    {
+        discardCost(data, tileAt(data, data->dynamicBlockWidth, data->dynamicBlockHeight, index));
+    }
+}
+
+void slaveDynamic(ConfigData* data)
+{
+    int tileWidth = data->dynamicBlockWidth;
+    int tileHeight = data->dynamicBlockHeight;
+
+    //Keep one buffer per tile that can be in flight so that a tile can be
+    //shaded while the previous one is still being sent to the master.
+    float* tilePixels[TILES_IN_FLIGHT];
+    PixelTransfer transfers[TILES_IN_FLIGHT];
+    for (int i = 0; i < TILES_IN_FLIGHT; i++)
+    {
+        tilePixels[i] = new float[3 * tileWidth * tileHeight];
+        transfers[i].request = MPI_REQUEST_NULL;
+        transfers[i].receiving = false;
+    }
+
+    //The tiles that the master said to drop because another slave already
+    //returned them, and the tiles that this slave shaded.
+    std::vector<char> cancelled(tileCount(data, tileWidth, tileHeight), 0);
+    std::vector<char> shaded(cancelled.size(), 0);
+
+    //The tiles that have been received but not yet shaded.
+    std::deque<int> pending;
 
-            //Calculate the index into the array.
-            int baseIndex = 3 * ( row * blockData.width + column );
-            if(j > blockData.width - 2)
+    int current = 0;
+    while (true)
+    {
+        //Wait for the next tile from the master, then take in whatever else
+        //it has already sent. The master sends a cancel after the tile it
+        //refers to, so this lets a copy that is queued behind the current
+        //tile be dropped before it is shaded.
+        double communicationStart = MPI_Wtime();
+        while (pending.empty())
+        {
+            receiveAssign(data, &pending, &cancelled, shaded);
+        }
+        int found = 1;
+        while (found && pending.back() != TILE_NONE)
+        {
+            MPI_Iprobe(0, TAG_TILE_ASSIGN, MPI_COMM_WORLD, &found, MPI_STATUS_IGNORE);
+            if (found)
             {
-                std::cout << "Slave " << data->mpi_rank << " rendering row " << i << " column " << j << std::endl;
-                std::cout << "Base index: " << baseIndex << std::endl;
-                std::cout << "Width: " << blockData.width << std::endl;
+                receiveAssign(data, &pending, &cancelled, shaded);
             }
-            //Call the function to shade the pixel.
-            shadePixel(&(pixels[baseIndex]),row,column,data);
         }
+        int index = pending.front();
+        pending.pop_front();
+        if (index == TILE_NONE)
+        {
+            recordTime(TIME_WAIT, MPI_Wtime() - communicationStart);
+            break;
+        }
+        if (cancelled[index])
+        {
+            //Tell the master that the tile was dropped, in its place in
+            //the order of the results.
+            MPI_Send(NULL, 0, MPI_INT, 0, TAG_TILE_SKIPPED, MPI_COMM_WORLD);
+            recordTime(TIME_WAIT, MPI_Wtime() - communicationStart);
+            continue;
+        }
+        Tile tile = tileAt(data, tileWidth, tileHeight, index);
+
+        //Make sure the buffer is no longer being sent before reusing it.
+        finishPixels(&transfers[current], 1);
+        recordTime(TIME_WAIT, MPI_Wtime() - communicationStart);
+
+        //Render the tile
+        shadeRegion(tilePixels[current], tile.row, tile.column, tile.width, tile.height, tile.width, data);
+        shaded[index] = 1;
+
+        //Send the tile back to the master without waiting for it to arrive.
+        communicationStart = MPI_Wtime();
+        startSendPixels(tilePixels[current], 3 * tile.width * tile.height, MPI_FLOAT, 0,
+            TAG_TILE_RESULT, &transfers[current]);
+        recordTime(TIME_WAIT, MPI_Wtime() - communicationStart);
+        current = (current + 1) % TILES_IN_FLIGHT;
     }
+
+    double communicationStart = MPI_Wtime();
+    finishPixels(transfers, TILES_IN_FLIGHT);
+    recordTime(TIME_WAIT, MPI_Wtime() - communicationStart);
+
+    //The master measures and tone maps the whole image, since some tiles
+    //may have been shaded by more than one slave.
+    discardLuminance();
+    recordTime(TIME_WAIT, combineLuminance());
+    for (int i = 0; i < TILES_IN_FLIGHT; i++)
+    {
+        delete[] tilePixels[i];
+    }
+}
+
+void slaveWorkStealing(ConfigData* data)
+{
+    //Render our share of the tiles along with everyone else.
+    std::vector<int> tiles;
+    std::vector<float> tilePixels;
+    double communicationTime = 0.0;
+    renderWorkStealing(data, &tiles, &tilePixels, &communicationTime);
+
+    //Tone map our tiles once the luminance of the whole image is known.
+    communicationTime += combineLuminance();
+    toneMapRegion(tilePixels.empty() ? NULL : &tilePixels[0], tilePixels.size() / 3, 1, 0);
+
+    //Tell the master which tiles we rendered and then send their pixels.
+    double communicationStart = MPI_Wtime();
+    int count = tiles.size();
+    MPI_Gather(&count, 1, MPI_INT, NULL, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Gatherv(tiles.empty() ? NULL : &tiles[0], count, MPI_INT,
+        NULL, NULL, NULL, MPI_INT, 0, MPI_COMM_WORLD);
+    sendPixels(tilePixels.empty() ? NULL : &tilePixels[0], tilePixels.size(), MPI_FLOAT, 0, 0);
+    communicationTime += MPI_Wtime() - communicationStart;
+    recordTime(TIME_WAIT, communicationTime);
+}
+
+void slaveStaticStripsHorizontal(ConfigData* data)
+{
+    //Work out which rows belong to this process.
+    Tile strip;
+    strip.row = stripStart(data->height, data->mpi_procs, data->mpi_rank);
+    strip.height = stripStart(data->height, data->mpi_procs, data->mpi_rank + 1) - strip.row;
+    strip.column = 0;
+    strip.width = data->width;
+
+    //Render the strip and send it back to the master process.
+    sendRegion(data, strip);
+}
+
+void slaveStaticCyclesHorizontal(ConfigData* data)
+{
+    //Render the rows of this process into one contiguous buffer.
+    int rows = cycleLines(data->height, data->cycleSize, data->mpi_procs, data->mpi_rank);
+    float* pixels = new float[3 * rows * data->width];
+    shadeRowCycles(data, data->mpi_rank, pixels, true);
+
+    //Tone map the rows once the luminance of the whole image is known.
+    recordTime(TIME_WAIT, combineLuminance());
+    toneMapRegion(pixels, data->width, rows, data->width);
+
     //Send the pixels back to the master process
-    MPI_Send(&pixels, 3 * blockData.width * blockData.height, MPI_FLOAT, 0, 0, MPI_COMM_WORLD);
-    std::cout << "Slave " << data->mpi_rank << " sent block back to master" << std::endl;
-}
\ No newline at end of file
+    double communicationStart = MPI_Wtime();
+    sendPixels(pixels, 3 * rows * data->width, MPI_FLOAT, 0, 0);
+    recordTime(TIME_WAIT, MPI_Wtime() - communicationStart);
+    delete[] pixels;
+}
+
+void slaveStaticCyclesVertical(ConfigData* data)
+{
+    //Render the columns of this process into one contiguous buffer.
+    int columns = cycleLines(data->width, data->cycleSize, data->mpi_procs, data->mpi_rank);
+    float* pixels = new float[3 * columns * data->height];
+    shadeColumnCycles(data, data->mpi_rank, pixels, true);
+
+    //Tone map the columns once the luminance of the whole image is known.
+    recordTime(TIME_WAIT, combineLuminance());
+    toneMapRegion(pixels, columns, data->height, columns);
+
+    //Send the pixels back to the master process one column at a time, which
+    //is the order that the master receives the columns in.
+    double communicationStart = MPI_Wtime();
+    MPI_Datatype column = columnType(data->height, columns);
+    sendPixels(pixels, columns, column, 0, 0);
+    recordTime(TIME_WAIT, MPI_Wtime() - communicationStart);
+    MPI_Type_free(&column);
+    delete[] pixels;
+}
+
+void slaveStaticCost(ConfigData* data)
+{
+    //Work out the same blocks as every other process.
+    std::vector<Tile> blocks;
+    std::vector<double> predicted;
+    balancedBlocks(data, &blocks, &predicted);
+    Tile block = blocks[data->mpi_rank];
+
+    //Render the block
+    float* pixels = new float[3 * block.width * block.height];
+    double shadeStart = MPI_Wtime();
+    shadeRegion(pixels, block.row, block.column, block.width, block.height, block.width, data);
+    double shadeTime = MPI_Wtime() - shadeStart;
+
+    //Tone map the block once the luminance of the whole image is known.
+    recordTime(TIME_WAIT, combineLuminance());
+    toneMapRegion(pixels, block.width, block.height, block.width);
+
+    //Send the pixels back to the master process, then how long they took.
+    double communicationStart = MPI_Wtime();
+    if (block.width > 0 && block.height > 0)
+    {
+        sendPixels(pixels, 3 * block.width * block.height, MPI_FLOAT, 0, 0);
+    }
+    MPI_Gather(&shadeTime, 1, MPI_DOUBLE, NULL, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    recordTime(TIME_WAIT, MPI_Wtime() - communicationStart);
+    delete[] pixels;
+}
@@ -0,0 +1,166 @@
+//This file contains the work stealing renderer that every process runs.
+
+#include <vector>
+#include <mpi.h>
+
+#include "RayTrace.h"
+#include "stealing.h"
+#include "threads.h"
+#include "tiles.h"
+
+//The layout of the range of tiles that each process exposes in its window.
+//The window of the master also holds the number of tiles that nobody has
+//taken yet, so that no process stops looking for work while there is any.
+#define RANGE_NEXT 0
+#define RANGE_END 1
+#define TILES_LEFT 2
+
+//Takes the next tile from the front of the range that belongs to the given
+//process. Returns false if the range is empty.
+static bool takeTile(MPI_Win window, int rank, int* index)
+{
+    int range[2];
+    MPI_Win_lock(MPI_LOCK_EXCLUSIVE, rank, 0, window);
+    MPI_Get(range, 2, MPI_INT, rank, RANGE_NEXT, 2, MPI_INT, window);
+    MPI_Win_flush(rank, window);
+
+    bool found = range[RANGE_NEXT] < range[RANGE_END];
+    if (found)
+    {
+        *index = range[RANGE_NEXT]++;
+        MPI_Put(&range[RANGE_NEXT], 1, MPI_INT, rank, RANGE_NEXT, 1, MPI_INT, window);
+    }
+    MPI_Win_unlock(rank, window);
+    return found;
+}
+
+//Moves the back half of the victim's remaining range into the range of
+//this process, which must be empty. Returns false if there was nothing to
+//take. A victim with a single tile left gives it up, since this process
+//has nothing else to do.
+static bool stealTiles(MPI_Win window, int rank, int victim)
+{
+    int range[2];
+    MPI_Win_lock(MPI_LOCK_EXCLUSIVE, victim, 0, window);
+    MPI_Get(range, 2, MPI_INT, victim, RANGE_NEXT, 2, MPI_INT, window);
+    MPI_Win_flush(victim, window);
+
+    int stolen = (range[RANGE_END] - range[RANGE_NEXT] + 1) / 2;
+    if (stolen > 0)
+    {
+        range[RANGE_END] -= stolen;
+        MPI_Put(&range[RANGE_END], 1, MPI_INT, victim, RANGE_END, 1, MPI_INT, window);
+    }
+    MPI_Win_unlock(victim, window);
+
+    if (stolen == 0)
+    {
+        return false;
+    }
+
+    int mine[2] = { range[RANGE_END], range[RANGE_END] + stolen };
+    MPI_Win_lock(MPI_LOCK_EXCLUSIVE, rank, 0, window);
+    MPI_Put(mine, 2, MPI_INT, rank, RANGE_NEXT, 2, MPI_INT, window);
+    MPI_Win_unlock(rank, window);
+    return true;
+}
+
+//Adds change to the number of tiles that nobody has taken yet, and returns
+//the number from before.
+static int updateTilesLeft(MPI_Win window, int change)
+{
+    int left;
+    MPI_Win_lock(MPI_LOCK_SHARED, 0, 0, window);
+    MPI_Fetch_and_op(&change, &left, MPI_INT, 0, TILES_LEFT, MPI_SUM, window);
+    MPI_Win_unlock(0, window);
+    return left;
+}
+
+void renderWorkStealing(ConfigData* data, std::vector<int>* tiles,
+    std::vector<float>* tilePixels, double* communicationTime)
+{
+    int tileWidth = data->dynamicBlockWidth;
+    int tileHeight = data->dynamicBlockHeight;
+    int totalTiles = tileCount(data, tileWidth, tileHeight);
+    std::vector<int> order = tileOrder(data, tileWidth, tileHeight);
+    int rank = data->mpi_rank;
+    int procs = data->mpi_procs;
+
+    double communicationStart = MPI_Wtime();
+
+    //Expose the range of tiles owned by this process to everyone else.
+    int* base;
+    MPI_Win window;
+    MPI_Win_allocate(3 * sizeof(int), sizeof(int), MPI_INFO_NULL, MPI_COMM_WORLD, &base, &window);
+
+    //Start with a contiguous share of the tiles.
+    int range[3];
+    range[RANGE_NEXT] = (int)((long long)totalTiles * rank / procs);
+    range[RANGE_END] = (int)((long long)totalTiles * (rank + 1) / procs);
+    range[TILES_LEFT] = totalTiles;
+    MPI_Win_lock(MPI_LOCK_EXCLUSIVE, rank, 0, window);
+    MPI_Put(range, 3, MPI_INT, rank, RANGE_NEXT, 3, MPI_INT, window);
+    MPI_Win_unlock(rank, window);
+
+    //Nobody may steal before every range has been set up.
+    MPI_Barrier(MPI_COMM_WORLD);
+    *communicationTime = MPI_Wtime() - communicationStart;
+
+    //Start looking for work at the next process so that the thieves are
+    //spread out over the victims.
+    int victim = (rank + 1) % procs;
+    while (true)
+    {
+        int position;
+        communicationStart = MPI_Wtime();
+        bool found = takeTile(window, rank, &position);
+
+        //Once our own range is empty, try every other process in turn.
+        for (int attempt = 1; attempt < procs && !found; attempt++)
+        {
+            if (stealTiles(window, rank, victim))
+            {
+                found = takeTile(window, rank, &position);
+            }
+            else
+            {
+                victim = (victim + 1) % procs;
+                if (victim == rank)
+                {
+                    victim = (victim + 1) % procs;
+                }
+            }
+        }
+
+        //Stolen tiles are only in the range of their thief once it has
+        //taken them from the victim, so a pass can miss tiles that are on
+        //their way from one process to another. Keep looking until every
+        //tile has been taken.
+        int left = updateTilesLeft(window, found ? -1 : 0);
+        *communicationTime += MPI_Wtime() - communicationStart;
+        if (!found)
+        {
+            if (left == 0)
+            {
+                break;
+            }
+            continue;
+        }
+
+        //The ranges hold positions in the order that the tiles are worked
+        //through in, so that every range is a compact part of the image.
+        int index = order[position];
+
+        //Render the tile at the end of the buffer.
+        Tile tile = tileAt(data, tileWidth, tileHeight, index);
+        size_t offset = tilePixels->size();
+        tilePixels->resize(offset + 3 * tile.width * tile.height);
+        shadeRegion(&((*tilePixels)[offset]), tile.row, tile.column, tile.width, tile.height, tile.width, data);
+        tiles->push_back(index);
+    }
+
+    //Freeing the window waits until every process has stopped stealing.
+    communicationStart = MPI_Wtime();
+    MPI_Win_free(&window);
+    *communicationTime += MPI_Wtime() - communicationStart;
+}
@@ -0,0 +1,222 @@
+//This file contains the pool of threads that shade pixels within a process.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <mpi.h>
+
+#include "RayTrace.h"
+#include "checkpoint.h"
+#include "heatmap.h"
+#include "options.h"
+#include "shade.h"
+#include "threads.h"
+#include "tiles.h"
+#include "timing.h"
+#include "tone.h"
+
+//The threads in the pool and their copies of the scene.
+static std::vector<std::thread> workers;
+static std::vector<ConfigData> views;
+
+//The region that is currently being shaded, and the rows or cells that it
+//is shaded in (see regionCells()). The threads take them one at a time.
+static float* jobPixels;
+static int jobRow, jobColumn, jobWidth, jobHeight, jobStride;
+static std::vector<Tile> jobCells;
+static std::atomic<int> nextPiece;
+
+//Used to wake the threads up for a new region and to wait for them to finish.
+static std::mutex mutex;
+static std::condition_variable wake, done;
+static int generation = 0;
+static int busy = 0;
+static bool stopping = false;
+
+//Shades a run of pixels in one row and hands them to the checkpoint.
+static void shadeRun(float* out, int row, int firstColumn, int width, ConfigData* data)
+{
+    if (costMap == NULL || !costPerPixel)
+    {
+        shadeSpan(out, row, firstColumn, width, data);
+    }
+    else
+    {
+        //Time every pixel on its own for the heatmap.
+        for (int column = 0; column < width; column++)
+        {
+            unsigned long long start = readTicks();
+            shadeSpan(&(out[3 * column]), row, firstColumn + column, 1, data);
+            costMap[row * data->width + firstColumn + column] = readTicks() - start;
+        }
+    }
+    checkpointPixels(out, row, firstColumn, width);
+}
+
+//Shades part of one row of the current region. The pixels that an earlier
+//run already shaded are taken from the checkpoint, and only the runs of
+//pixels in between are shaded.
+static void shadeRowPart(int row, int firstColumn, int width, unsigned char* finished, ConfigData* data)
+{
+    float* out = &(jobPixels[3 * (row * jobStride + firstColumn)]);
+    restorePixels(out, jobRow + row, jobColumn + firstColumn, width, finished);
+    for (int start = 0; start < width; )
+    {
+        int end = start;
+        while (end < width && !finished[end])
+        {
+            end++;
+        }
+        if (end > start)
+        {
+            shadeRun(&(out[3 * start]), jobRow + row, jobColumn + firstColumn + start, end - start, data);
+        }
+        start = end + 1;
+    }
+}
+
+//Shades rows or cells of the current region until there are none left.
+static void shadeRows(ConfigData* data)
+{
+    std::vector<unsigned char> finished(jobWidth);
+    unsigned char* map = finished.empty() ? NULL : &finished[0];
+    int piece;
+    while ((piece = nextPiece++) < (int)jobCells.size())
+    {
+        const Tile& cell = jobCells[piece];
+        for (int row = cell.row; row < cell.row + cell.height; row++)
+        {
+            shadeRowPart(row, cell.column, cell.width, map, data);
+        }
+    }
+}
+
+static void workerMain(int id)
+{
+    int seen = 0;
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping)
+        {
+            return;
+        }
+        seen = generation;
+        lock.unlock();
+
+        shadeRows(&views[id]);
+
+        lock.lock();
+        if (--busy == 0)
+        {
+            done.notify_one();
+        }
+    }
+}
+
+bool startThreads(ConfigData* data)
+{
+    int helpers = renderOptions.threads - 1;
+    if (helpers <= 0)
+    {
+        return false;
+    }
+
+    //Load a copy of the scene for every thread, all at the same time.
+    views.resize(helpers);
+    std::vector<char> failed(helpers, 0);
+    std::vector<std::thread> loaders;
+    for (int i = 0; i < helpers; i++)
+    {
+        loaders.push_back(std::thread([&, i] {
+            int argc = renderOptions.sceneArgc;
+            char** argv = renderOptions.sceneArgv;
+            failed[i] = initialize(&argc, &argv, &views[i]);
+            views[i].mpi_rank = data->mpi_rank;
+            views[i].mpi_procs = data->mpi_procs;
+            views[i].partitioningMode = data->partitioningMode;
+        }));
+    }
+    for (int i = 0; i < helpers; i++)
+    {
+        loaders[i].join();
+    }
+    for (int i = 0; i < helpers; i++)
+    {
+        if (failed[i])
+        {
+            return true;
+        }
+    }
+
+    for (int i = 0; i < helpers; i++)
+    {
+        workers.push_back(std::thread(workerMain, i));
+    }
+    return false;
+}
+
+void stopThreads()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+    for (size_t i = 0; i < views.size(); i++)
+    {
+        shutdown(&views[i]);
+    }
+    workers.clear();
+    views.clear();
+    stopping = false;
+}
+
+void shadeRegion(float* pixels, int firstRow, int firstColumn, int width,
+    int height, int stride, ConfigData* data)
+{
+    double shadeStart = MPI_Wtime();
+    unsigned long long startTicks = readTicks();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobPixels = pixels;
+        jobRow = firstRow;
+        jobColumn = firstColumn;
+        jobWidth = width;
+        jobHeight = height;
+        jobStride = stride;
+        jobCells = regionCells(width, height, renderOptions.tileOrder);
+        nextPiece = 0;
+        busy = workers.size();
+        generation++;
+    }
+    wake.notify_all();
+
+    //The calling thread works on the region as well.
+    shadeRows(data);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [] { return busy == 0; });
+    recordTime(TIME_SHADE, MPI_Wtime() - shadeStart);
+
+    //Spread the time of the region evenly over its pixels.
+    if (costMap != NULL && !costPerPixel && width > 0 && height > 0)
+    {
+        float cost = (float)(readTicks() - startTicks) / ((float)width * height);
+        for (int row = firstRow; row < firstRow + height; row++)
+        {
+            std::fill(&costMap[row * data->width + firstColumn],
+                &costMap[row * data->width + firstColumn + width], cost);
+        }
+    }
+    rankTiming.pixels += (double)width * height;
+    measureLuminance(pixels, width, height, stride);
+}
@@ -0,0 +1,145 @@
+//This file contains the helpers used to split the image into tiles.
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "RayTrace.h"
+#include "options.h"
+#include "tiles.h"
+
+int tileCount(ConfigData* data, int tileWidth, int tileHeight)
+{
+    int tilesX = (data->width + tileWidth - 1) / tileWidth;
+    int tilesY = (data->height + tileHeight - 1) / tileHeight;
+    return tilesX * tilesY;
+}
+
+Tile tileAt(ConfigData* data, int tileWidth, int tileHeight, int index)
+{
+    int tilesX = (data->width + tileWidth - 1) / tileWidth;
+
+    Tile tile;
+    tile.row = (index / tilesX) * tileHeight;
+    tile.column = (index % tilesX) * tileWidth;
+    tile.width = tileWidth;
+    tile.height = tileHeight;
+
+    //Clip the tiles on the right and bottom edges of the image.
+    if (tile.column + tile.width > data->width)
+    {
+        tile.width = data->width - tile.column;
+    }
+    if (tile.row + tile.height > data->height)
+    {
+        tile.height = data->height - tile.row;
+    }
+    return tile;
+}
+
+//Returns the distance along a Z-order curve of the cell at (x, y), which
+//interleaves the bits of the two coordinates.
+static long long mortonKey(int x, int y)
+{
+    long long key = 0;
+    for (int bit = 0; bit < 31; bit++)
+    {
+        key |= (long long)((x >> bit) & 1) << (2 * bit);
+        key |= (long long)((y >> bit) & 1) << (2 * bit + 1);
+    }
+    return key;
+}
+
+//Returns the distance along a Hilbert curve over a side x side square of
+//the cell at (x, y). side must be a power of two.
+static long long hilbertKey(int side, int x, int y)
+{
+    long long key = 0;
+    for (int half = side / 2; half > 0; half /= 2)
+    {
+        int right = (x & half) ? 1 : 0;
+        int lower = (y & half) ? 1 : 0;
+        key += (long long)half * half * ((3 * right) ^ lower);
+
+        //Turn the quadrant so that the curve inside it starts and ends in
+        //the right corners.
+        if (lower == 0)
+        {
+            if (right == 1)
+            {
+                x = side - 1 - x;
+                y = side - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return key;
+}
+
+std::vector<int> curveOrder(int columns, int rows, TileOrder order)
+{
+    int count = columns * rows;
+    std::vector<std::pair<long long, int> > cells(count);
+    int side = 1;
+    while (side < columns || side < rows)
+    {
+        side *= 2;
+    }
+    for (int cell = 0; cell < count; cell++)
+    {
+        int x = cell % columns;
+        int y = cell / columns;
+        long long key = cell;
+        if (order == ORDER_MORTON)
+        {
+            key = mortonKey(x, y);
+        }
+        else if (order == ORDER_HILBERT)
+        {
+            key = hilbertKey(side, x, y);
+        }
+        cells[cell] = std::make_pair(key, cell);
+    }
+    std::sort(cells.begin(), cells.end());
+
+    std::vector<int> cellOrder(count);
+    for (int i = 0; i < count; i++)
+    {
+        cellOrder[i] = cells[i].second;
+    }
+    return cellOrder;
+}
+
+std::vector<Tile> regionCells(int width, int height, TileOrder order)
+{
+    std::vector<Tile> cells;
+    if (order == ORDER_ROWS)
+    {
+        for (int row = 0; row < height; row++)
+        {
+            Tile cell = { row, 0, width, 1 };
+            cells.push_back(cell);
+        }
+        return cells;
+    }
+
+    int cellsX = (width + CELL_SIZE - 1) / CELL_SIZE;
+    std::vector<int> cellOrder = curveOrder(cellsX, (height + CELL_SIZE - 1) / CELL_SIZE, order);
+    for (size_t i = 0; i < cellOrder.size(); i++)
+    {
+        Tile cell;
+        cell.row = (cellOrder[i] / cellsX) * CELL_SIZE;
+        cell.column = (cellOrder[i] % cellsX) * CELL_SIZE;
+        cell.width = std::min(CELL_SIZE, width - cell.column);
+        cell.height = std::min(CELL_SIZE, height - cell.row);
+        cells.push_back(cell);
+    }
+    return cells;
+}
+
+std::vector<int> tileOrder(ConfigData* data, int tileWidth, int tileHeight)
+{
+    int tilesX = (data->width + tileWidth - 1) / tileWidth;
+    int tilesY = (data->height + tileHeight - 1) / tileHeight;
+    return curveOrder(tilesX, tilesY, renderOptions.tileOrder);
+}
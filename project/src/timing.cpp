@@ -0,0 +1,182 @@
+//This file contains the code that collects and prints the timing of every
+//process.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <mpi.h>
+
+#include "RayTrace.h"
+#include "options.h"
+#include "timing.h"
+
+RankTiming rankTiming = { { 0.0, 0.0, 0.0, 0.0 }, 0.0 };
+
+//The number of doubles in a RankTiming.
+#define TIMING_VALUES (sizeof(RankTiming) / sizeof(double))
+
+//The names of the kinds of time, including the time that is not accounted
+//for by the other kinds.
+static const char* kindNames[] = { "shade", "wait", "copy", "total", "other" };
+static const char* kindLabels[] = { "Shading", "MPI Wait", "Copy", "Total", "Other" };
+#define KIND_OTHER TIME_KINDS
+
+//Returns the name that selects the partitioning scheme with -p.
+static const char* schemeName(PartType mode)
+{
+    switch ((int)mode)
+    {
+        case PART_MODE_NONE:
+            return "none";
+        case PART_MODE_STATIC_STRIPS_HORIZONTAL:
+            return "static_strips_horizontal";
+        case PART_MODE_STATIC_STRIPS_VERTICAL:
+            return "static_strips_vertical";
+        case PART_MODE_STATIC_BLOCKS:
+            return "static_blocks";
+        case PART_MODE_STATIC_CYCLES_HORIZONTAL:
+            return "static_cycles_horizontal";
+        case PART_MODE_STATIC_CYCLES_VERTICAL:
+            return "static_cycles_vertical";
+        case PART_MODE_DYNAMIC:
+            return "dynamic";
+        case PART_MODE_WORK_STEALING:
+            return "work_stealing";
+        case PART_MODE_STATIC_COST:
+            return "static_cost";
+        default:
+            return "unknown";
+    }
+}
+
+//Returns one kind of time of a process, or the pixel count for kind -1.
+static double timingValue(const RankTiming& timing, int kind)
+{
+    if (kind < 0)
+    {
+        return timing.pixels;
+    }
+    if (kind == KIND_OTHER)
+    {
+        double other = timing.seconds[TIME_TOTAL];
+        for (int i = 0; i < TIME_TOTAL; i++)
+        {
+            other -= timing.seconds[i];
+        }
+        return other > 0.0 ? other : 0.0;
+    }
+    return timing.seconds[kind];
+}
+
+//Prints the minimum, mean and maximum of one value over the processes.
+static void printSummary(const char* label, const std::vector<RankTiming>& timings, int kind)
+{
+    double minimum = timingValue(timings[0], kind);
+    double maximum = minimum;
+    double sum = 0.0;
+    for (size_t i = 0; i < timings.size(); i++)
+    {
+        double value = timingValue(timings[i], kind);
+        minimum = std::min(minimum, value);
+        maximum = std::max(maximum, value);
+        sum += value;
+    }
+    double mean = sum / timings.size();
+    double imbalance = mean > 0.0 ? maximum / mean : 1.0;
+    printf("    %-10s %12.6f %12.6f %12.6f %10.3f\n", label, minimum, mean, maximum, imbalance);
+}
+
+//Returns max / mean of one value over the processes.
+static double imbalanceOf(const std::vector<RankTiming>& timings, int kind)
+{
+    double maximum = 0.0, sum = 0.0;
+    for (size_t i = 0; i < timings.size(); i++)
+    {
+        maximum = std::max(maximum, timingValue(timings[i], kind));
+        sum += timingValue(timings[i], kind);
+    }
+    return sum > 0.0 ? maximum * timings.size() / sum : 1.0;
+}
+
+static void printJson(ConfigData* data, const std::vector<RankTiming>& timings)
+{
+    printf("{\"scheme\":\"%s\",\"procs\":%d,\"threads\":%d,\"width\":%d,\"height\":%d,\"ranks\":[",
+        schemeName(data->partitioningMode), data->mpi_procs, renderOptions.threads,
+        data->width, data->height);
+    for (size_t i = 0; i < timings.size(); i++)
+    {
+        printf("%s{\"rank\":%d,\"pixels\":%.0f", i ? "," : "", (int)i, timings[i].pixels);
+        for (int kind = 0; kind <= KIND_OTHER; kind++)
+        {
+            printf(",\"%s\":%.6f", kindNames[kind], timingValue(timings[i], kind));
+        }
+        printf("}");
+    }
+    printf("],\"imbalance\":{\"shade\":%.4f,\"total\":%.4f}}\n",
+        imbalanceOf(timings, TIME_SHADE), imbalanceOf(timings, TIME_TOTAL));
+}
+
+static void printCsv(ConfigData* data, const std::vector<RankTiming>& timings)
+{
+    for (size_t i = 0; i < timings.size(); i++)
+    {
+        printf("timing,%s,%d,%d,%d,%d,%d,%.0f", schemeName(data->partitioningMode),
+            data->mpi_procs, renderOptions.threads, data->width, data->height, (int)i,
+            timings[i].pixels);
+        for (int kind = 0; kind <= KIND_OTHER; kind++)
+        {
+            printf(",%.6f", timingValue(timings[i], kind));
+        }
+        printf("\n");
+    }
+}
+
+void reportTiming(ConfigData* data)
+{
+    std::vector<RankTiming> timings(data->mpi_rank == 0 ? data->mpi_procs : 0);
+    MPI_Gather(&rankTiming, TIMING_VALUES, MPI_DOUBLE, timings.empty() ? NULL : &timings[0],
+        TIMING_VALUES, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (data->mpi_rank != 0)
+    {
+        return;
+    }
+
+    //Keep the report together with the rest of the master's output.
+    std::cout.flush();
+    printf("\nPer-Process Timing (seconds):\n");
+    printf("    %-6s %10s", "Rank", "Pixels");
+    for (int kind = 0; kind <= KIND_OTHER; kind++)
+    {
+        printf(" %12s", kindLabels[kind]);
+    }
+    printf("\n");
+    for (size_t i = 0; i < timings.size(); i++)
+    {
+        printf("    %-6d %10.0f", (int)i, timings[i].pixels);
+        for (int kind = 0; kind <= KIND_OTHER; kind++)
+        {
+            printf(" %12.6f", timingValue(timings[i], kind));
+        }
+        printf("\n");
+    }
+
+    printf("    %-10s %12s %12s %12s %10s\n", "", "Min", "Mean", "Max", "Max/Mean");
+    printSummary("Pixels", timings, -1);
+    for (int kind = 0; kind <= KIND_OTHER; kind++)
+    {
+        printSummary(kindLabels[kind], timings, kind);
+    }
+    printf("\n");
+
+    if (renderOptions.reportFormat != NULL && strcmp(renderOptions.reportFormat, "json") == 0)
+    {
+        printJson(data, timings);
+    }
+    else if (renderOptions.reportFormat != NULL)
+    {
+        printCsv(data, timings);
+    }
+    fflush(stdout);
+}
@@ -0,0 +1,124 @@
+//This file contains the code that tone maps the image.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mpi.h>
+
+#include "RayTrace.h"
+#include "options.h"
+#include "tone.h"
+
+//Keeps the logarithm of black pixels finite.
+#define LUMINANCE_DELTA 0.0001
+
+//The sums of this process: the sum of the logarithms of the luminance, the
+//number of pixels and the largest luminance.
+static double logSum = 0.0;
+static double pixelCount = 0.0;
+static double maxLuminance = 0.0;
+
+//The operator for the current image. Reinhard's operator scales the
+//luminance by scale and maps white to 1; Ward's multiplies every channel
+//by scale.
+static bool reinhard = false;
+static double scale = 1.0;
+static double white = 1.0;
+
+//Returns the luminance of a pixel.
+static double luminance(const float* color)
+{
+    return 0.27 * color[0] + 0.67 * color[1] + 0.06 * color[2];
+}
+
+bool toneMapping()
+{
+    return renderOptions.toneOperator != NULL;
+}
+
+void measureLuminance(const float* pixels, int width, int height, int stride)
+{
+    if (!toneMapping())
+    {
+        return;
+    }
+    for (int row = 0; row < height; row++)
+    {
+        const float* color = &pixels[3 * row * stride];
+        for (int column = 0; column < width; column++, color += 3)
+        {
+            double value = luminance(color);
+            logSum += log(LUMINANCE_DELTA + value);
+            maxLuminance = std::max(maxLuminance, value);
+        }
+    }
+    pixelCount += (double)width * height;
+}
+
+void discardLuminance()
+{
+    logSum = 0.0;
+    pixelCount = 0.0;
+    maxLuminance = 0.0;
+}
+
+double combineLuminance()
+{
+    if (!toneMapping())
+    {
+        return 0.0;
+    }
+
+    double start = MPI_Wtime();
+    double sums[2] = { logSum, pixelCount };
+    double totals[2], largest;
+    MPI_Allreduce(sums, totals, 2, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(&maxLuminance, &largest, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    double seconds = MPI_Wtime() - start;
+    discardLuminance();
+
+    double average = totals[1] > 0.0 ? exp(totals[0] / totals[1]) : 1.0;
+    reinhard = strcmp(renderOptions.toneOperator, "reinhard") == 0;
+    if (reinhard)
+    {
+        //Reinhard et al.: scale the image to the key, and let the
+        //brightest pixel be white.
+        scale = renderOptions.toneKey / average;
+        white = std::max(scale * largest, (double)LUMINANCE_DELTA);
+    }
+    else
+    {
+        //Ward: the image is in units of the display's white, so the
+        //world adaptation luminance is the average times that.
+        double display = renderOptions.toneDisplay;
+        double adaptation = average * display;
+        scale = pow((1.219 + pow(display / 2.0, 0.4)) / (1.219 + pow(adaptation, 0.4)), 2.5);
+    }
+    return seconds;
+}
+
+void toneMapRegion(float* pixels, int width, int height, int stride)
+{
+    if (!toneMapping())
+    {
+        return;
+    }
+    for (int row = 0; row < height; row++)
+    {
+        float* color = &pixels[3 * row * stride];
+        for (int column = 0; column < width; column++, color += 3)
+        {
+            float factor = scale;
+            if (reinhard)
+            {
+                //Map the luminance and keep the hue.
+                double value = scale * luminance(color);
+                double mapped = value * (1.0 + value / (white * white)) / (1.0 + value);
+                factor = value > 0.0 ? scale * mapped / value : 0.0f;
+            }
+            color[0] *= factor;
+            color[1] *= factor;
+            color[2] *= factor;
+        }
+    }
+}
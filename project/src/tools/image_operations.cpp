@@ -1,171 +1,446 @@
-#define PNG_DEBUG (3)
+//This file contains a program that compares two PNG files pixel by pixel.
+//
+//Both images are decoded a band of rows at a time, in lockstep, so only a
+//few rows of each are in memory at once. Every row is first compared with
+//SIMD instructions, which find the largest difference and the squared
+//error of the row; only the rows that differ by more than the tolerance
+//are looked at pixel by pixel.
+//
+//The exit code is 0 if the images match, 1 if they differ and 2 if they
+//could not be compared.
+
 #include <png.h>
-#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
+//The number of rows that are decoded from each image at a time.
+#define BAND_ROWS 64
+
+//The exit codes.
+#define EXIT_MATCH 0
+#define EXIT_DIFFERENT 1
+#define EXIT_ERROR 2
+
+//Reads a PNG file a few rows at a time as 8-bit RGB.
 typedef struct
 {
-    png_structp png_ptr;
-    png_infop info_ptr;
-    int width, height, number_of_passes;
-    unsigned char color_type, bit_depth;
-    png_bytep* row_pointers;
+    FILE* file;
+    png_structp png;
+    png_infop info;
+    int width, height;
+
+    //Interlaced images cannot be read a row at a time, so they are read
+    //whole into here and handed out from it.
+    std::vector<unsigned char> whole;
+    int nextRow;
 } Image;
 
-bool read_png_file(char* file, Image* image)
+//One pixel that differs.
+typedef struct
+{
+    int row, column;
+    unsigned char first[3], second[3];
+} Difference;
+
+//What was found in some of the rows of the images.
+typedef struct
+{
+    long long differing;
+    int maxError;
+    double squaredError;
+    int top, left, bottom, right;
+
+    //The first differences, in order, for printing.
+    std::vector<Difference> listed;
+} Stats;
+
+static void resetStats(Stats* stats)
 {
-    bool value = false;
+    stats->differing = 0;
+    stats->maxError = 0;
+    stats->squaredError = 0.0;
+    stats->top = stats->left = 1 << 30;
+    stats->bottom = stats->right = -1;
+    stats->listed.clear();
+}
+
+bool openImage(const char* name, Image* image)
+{
+    image->file = fopen(name, "rb");
+    image->png = NULL;
+    image->info = NULL;
+    if (image->file == NULL)
+    {
+        std::cerr << "The file (" << name << ") could not be opened." << std::endl;
+        return false;
+    }
 
-    //Keep space for the file header.
     png_byte header[8];
+    if (fread(header, 1, 8, image->file) != 8 || png_sig_cmp(header, 0, 8))
+    {
+        std::cerr << "The file (" << name << ") does not appear to be png." << std::endl;
+        return false;
+    }
 
-    //Try to open the file.
-    FILE* fp = fopen(file, "rb");
-    if(fp != NULL)
+    image->png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    image->info = image->png ? png_create_info_struct(image->png) : NULL;
+    if (image->info == NULL)
+    {
+        std::cerr << "Creation of read struct failed." << std::endl;
+        return false;
+    }
+    if (setjmp(png_jmpbuf(image->png)))
     {
-        //Read the first 8 bytes of the file.
-        fread(header, 1, 8, fp);
+        std::cerr << "Error during read initialization of " << name << "." << std::endl;
+        return false;
+    }
+    png_init_io(image->png, image->file);
+    png_set_sig_bytes(image->png, 8);
+    png_read_info(image->png, image->info);
+    image->width = png_get_image_width(image->png, image->info);
+    image->height = png_get_image_height(image->png, image->info);
 
-        //Check the header.
-        if(!png_sig_cmp(header, 0, 8))
+    //Compare every image as 8-bit RGB, whatever it was saved as.
+    png_set_expand(image->png);
+    png_set_strip_16(image->png);
+    png_set_strip_alpha(image->png);
+    png_set_gray_to_rgb(image->png);
+    int passes = png_set_interlace_handling(image->png);
+    png_read_update_info(image->png, image->info);
+
+    image->nextRow = 0;
+    if (passes > 1)
+    {
+        image->whole.resize(3 * (size_t)image->width * image->height);
+        std::vector<png_bytep> rows(image->height);
+        for (int row = 0; row < image->height; row++)
         {
-            image->png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-            if(image->png_ptr != NULL)
-            {
-                image->info_ptr = png_create_info_struct(image->png_ptr);
-                if(image->info_ptr != NULL)
-                {
-                    if(setjmp(png_jmpbuf(image->png_ptr)))
-                    {
-                        std::cerr << "Error during read initialization." << std::endl;
-                    }
-                    else
-                    {
-                        //Now let's begin to read the image.
-                        png_init_io(image->png_ptr, fp);
-                        png_set_sig_bytes(image->png_ptr, 8);
-                        png_read_info(image->png_ptr, image->info_ptr);
-                        
-                        image->width = png_get_image_width(image->png_ptr, image->info_ptr);
-                        image->height = png_get_image_height(image->png_ptr, image->info_ptr);
-                        image->color_type = png_get_color_type(image->png_ptr, image->info_ptr);
-                        image->bit_depth = png_get_bit_depth(image->png_ptr, image->info_ptr);
-
-                        image->number_of_passes = png_set_interlace_handling(image->png_ptr);
-                        png_read_update_info(image->png_ptr, image->info_ptr);
-
-                        if(setjmp(png_jmpbuf(image->png_ptr)))
-                        {
-                            std::cerr << "Error during read." << std::endl;
-                        }
-                        else
-                        {
-                            //Allocate space for image.
-                            image->row_pointers = new png_bytep[image->height];
-                            for(int y = 0; y < image->height; ++y)
-                            {
-                                (image->row_pointers)[y] = (png_byte*)malloc(png_get_rowbytes(image->png_ptr, image->info_ptr));
-                            }
-
-                            png_read_image(image->png_ptr, image->row_pointers);
-                            value = true;
-                            fclose(fp);
-                        }
-                    }
-                }
-                else
-                { 
-                    std::cerr << "Info struct creation failed." << std::endl;
-                }
-            }
-            else
-            {
-                std::cerr << "Creation of read struct failed." << std::endl;
-            }
+            rows[row] = &image->whole[3 * (size_t)image->width * row];
         }
-        else
+        png_read_image(image->png, &rows[0]);
+    }
+    return true;
+}
+
+//Reads the next rows of the image into the buffer, one after another.
+bool readRows(Image* image, unsigned char* buffer, int rows)
+{
+    size_t rowBytes = 3 * (size_t)image->width;
+    if (!image->whole.empty())
+    {
+        memcpy(buffer, &image->whole[rowBytes * image->nextRow], rowBytes * rows);
+        image->nextRow += rows;
+        return true;
+    }
+    if (setjmp(png_jmpbuf(image->png)))
+    {
+        std::cerr << "Error during read." << std::endl;
+        return false;
+    }
+    for (int row = 0; row < rows; row++)
+    {
+        png_read_row(image->png, buffer + rowBytes * row, NULL);
+    }
+    image->nextRow += rows;
+    return true;
+}
+
+void closeImage(Image* image)
+{
+    if (image->png != NULL)
+    {
+        png_destroy_read_struct(&image->png, image->info ? &image->info : NULL, NULL);
+    }
+    if (image->file != NULL)
+    {
+        fclose(image->file);
+    }
+}
+
+//Finds the largest difference between two rows of bytes and adds up the
+//squared differences.
+static int compareBytes(const unsigned char* a, const unsigned char* b, int count, double* squaredError)
+{
+    int i = 0;
+    int maxError = 0;
+    unsigned long long sum = 0;
+#if defined(__SSE2__)
+    __m128i largest = _mm_setzero_si128();
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+        __m128i error = _mm_or_si128(_mm_subs_epu8(x, y), _mm_subs_epu8(y, x));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(error, zero)) == 0xFFFF)
         {
-            std::cerr << "The file (" << file << ") does not appear to be png." << std::endl;
+            continue;
         }
+        largest = _mm_max_epu8(largest, error);
+
+        //Square the differences as 16-bit values and add them up in pairs.
+        __m128i low = _mm_unpacklo_epi8(error, zero);
+        __m128i high = _mm_unpackhi_epi8(error, zero);
+        __m128i squares = _mm_add_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high));
+        unsigned int parts[4];
+        _mm_storeu_si128((__m128i*)parts, squares);
+        sum += (unsigned long long)parts[0] + parts[1] + parts[2] + parts[3];
     }
-    else
+    unsigned char lanes[16];
+    _mm_storeu_si128((__m128i*)lanes, largest);
+    for (int lane = 0; lane < 16; lane++)
     {
-       std::cerr << "The file (" << file << ") could not be opened." << std::endl;
+        maxError = std::max(maxError, (int)lanes[lane]);
     }
+#endif
+    for (; i < count; i++)
+    {
+        int error = abs((int)a[i] - (int)b[i]);
+        maxError = std::max(maxError, error);
+        sum += error * error;
+    }
+    *squaredError += (double)sum;
+    return maxError;
+}
+
+//Compares rows of the two images and adds what was found to the stats.
+static void compareRows(const unsigned char* a, const unsigned char* b, int firstRow, int rows,
+    int width, int tolerance, size_t listLimit, Stats* stats)
+{
+    for (int row = 0; row < rows; row++)
+    {
+        const unsigned char* x = a + 3 * (size_t)width * row;
+        const unsigned char* y = b + 3 * (size_t)width * row;
+        int maxError = compareBytes(x, y, 3 * width, &stats->squaredError);
+        stats->maxError = std::max(stats->maxError, maxError);
+        if (maxError <= tolerance)
+        {
+            continue;
+        }
 
-    return value;
+        //Only now look for the pixels that differ.
+        for (int column = 0; column < width; column++, x += 3, y += 3)
+        {
+            if (abs((int)x[0] - (int)y[0]) <= tolerance && abs((int)x[1] - (int)y[1]) <= tolerance &&
+                abs((int)x[2] - (int)y[2]) <= tolerance)
+            {
+                continue;
+            }
+            stats->differing++;
+            stats->top = std::min(stats->top, firstRow + row);
+            stats->bottom = std::max(stats->bottom, firstRow + row);
+            stats->left = std::min(stats->left, column);
+            stats->right = std::max(stats->right, column);
+            if (stats->listed.size() < listLimit)
+            {
+                Difference difference;
+                difference.row = firstRow + row;
+                difference.column = column;
+                memcpy(difference.first, x, 3);
+                memcpy(difference.second, y, 3);
+                stats->listed.push_back(difference);
+            }
+        }
+    }
 }
 
-void deleteImage(Image* image)
+//Adds the stats of later rows to the stats of earlier ones.
+static void mergeStats(Stats* into, const Stats& from, size_t listLimit)
 {
-    for(int y = 0; y < image->height; ++y)
+    into->differing += from.differing;
+    into->maxError = std::max(into->maxError, from.maxError);
+    into->squaredError += from.squaredError;
+    into->top = std::min(into->top, from.top);
+    into->left = std::min(into->left, from.left);
+    into->bottom = std::max(into->bottom, from.bottom);
+    into->right = std::max(into->right, from.right);
+    for (size_t i = 0; i < from.listed.size() && into->listed.size() < listLimit; i++)
     {
-        free((image->row_pointers)[y]);
+        into->listed.push_back(from.listed[i]);
     }
-    delete[] image->row_pointers;
 }
 
-void compare_images(Image* im1, Image* im2)
+int compareImages(Image* im1, Image* im2, int tolerance, int threads, size_t listLimit, Stats* stats)
 {
     //Check the width and height.
-    if( (im1->height == im2->height) && (im1->width == im2->width) )
+    if (im1->height != im2->height || im1->width != im2->width)
     {
-        //Keep a counter for the number of different pixels.
-        int differing = 0;
+        std::cout << "ERROR: Images have different dimensions (" << im1->width << " x " << im1->height;
+        std::cout << " and " << im2->width << " x " << im2->height << ")" << std::endl;
+        return EXIT_ERROR;
+    }
+
+    int width = im1->width;
+    std::vector<unsigned char> band1(3 * (size_t)width * BAND_ROWS);
+    std::vector<unsigned char> band2(3 * (size_t)width * BAND_ROWS);
+    std::vector<Stats> parts(threads);
+    resetStats(stats);
+    for (int firstRow = 0; firstRow < im1->height; firstRow += BAND_ROWS)
+    {
+        int rows = std::min(BAND_ROWS, im1->height - firstRow);
 
-        //Now, check each of the values in the image for equality.
-        for(int row = 0; row < im1->height; ++row)
+        //Decode the same rows of both images, at the same time when there
+        //is more than one thread.
+        bool read1 = true, read2;
+        std::thread reader;
+        if (threads > 1)
+        {
+            reader = std::thread([&] { read1 = readRows(im1, &band1[0], rows); });
+        }
+        else
+        {
+            read1 = readRows(im1, &band1[0], rows);
+        }
+        read2 = readRows(im2, &band2[0], rows);
+        if (reader.joinable())
         {
-            png_byte* im1r = (im1->row_pointers)[row];
-            png_byte* im2r = (im2->row_pointers)[row];
-            for(int column = 0; column < im1->width; ++column)
+            reader.join();
+        }
+        if (!read1 || !read2)
+        {
+            return EXIT_ERROR;
+        }
+
+        //Split the rows of the band between the threads.
+        std::vector<std::thread> workers;
+        for (int i = 0; i < threads; i++)
+        {
+            int start = rows * i / threads;
+            int end = rows * (i + 1) / threads;
+            resetStats(&parts[i]);
+            size_t offset = 3 * (size_t)width * start;
+            if (i + 1 < threads)
+            {
+                workers.push_back(std::thread(compareRows, &band1[offset], &band2[offset], firstRow + start,
+                    end - start, width, tolerance, listLimit, &parts[i]));
+            }
+            else
             {
-                //Determine if the pixels are the same by comparing each of the RGB values.
-                if( (im1r[0] != im2r[0]) || (im1r[1] != im2r[1])
-                    || (im1r[2] != im2r[2]) )
-                {
-                    //We have encountered a difference here...
-                    std::cout << "ERROR: Pixel (" << row << "," << column << ") is different.";
-                    std::cout << " (R,G,B) values: 1.) (" << (int)im1r[0] << "," << (int)im1r[1] << "," << (int)im1r[2] << "); ";
-                    std::cout << "2.) (" << (int)im2r[0] << "," << (int)im2r[1] << "," << (int)im2r[2] << ")" << std::endl;
-
-                    //Mark it as a difference.
-                    differing++;
-                }
-
-                //Update the pointers to the next pixel.
-                im1r += 3; im2r += 3;
+                compareRows(&band1[offset], &band2[offset], firstRow + start, end - start, width,
+                    tolerance, listLimit, &parts[i]);
             }
         }
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            workers[i].join();
+        }
+        for (int i = 0; i < threads; i++)
+        {
+            mergeStats(stats, parts[i], listLimit);
+        }
+    }
+    return stats->differing > 0 ? EXIT_DIFFERENT : EXIT_MATCH;
+}
+
+void printStats(const Stats& stats, int width, int height)
+{
+    for (size_t i = 0; i < stats.listed.size(); i++)
+    {
+        const Difference& d = stats.listed[i];
+        std::cout << "ERROR: Pixel (" << d.row << "," << d.column << ") is different.";
+        std::cout << " (R,G,B) values: 1.) (" << (int)d.first[0] << "," << (int)d.first[1] << "," << (int)d.first[2] << "); ";
+        std::cout << "2.) (" << (int)d.second[0] << "," << (int)d.second[1] << "," << (int)d.second[2] << ")" << std::endl;
+    }
+    if (stats.differing > (long long)stats.listed.size())
+    {
+        std::cout << "... and " << stats.differing - stats.listed.size() << " more" << std::endl;
+    }
 
-        //Print the summary.
-        std::cout << std::endl << std::endl;
-        std::cout << "Number of different pixels: " << differing << std::endl;
-        std::cout << "Percent of image: " << (100.0 * differing / (im1->height * im1->width)) << "%" << std::endl;
+    //Print the summary.
+    double pixels = (double)width * height;
+    std::cout << std::endl << std::endl;
+    std::cout << "Number of different pixels: " << stats.differing << std::endl;
+    std::cout << "Percent of image: " << (100.0 * stats.differing / pixels) << "%" << std::endl;
+    std::cout << "Maximum difference: " << stats.maxError << std::endl;
+    double meanSquaredError = stats.squaredError / (3.0 * pixels);
+    if (meanSquaredError > 0.0)
+    {
+        std::cout << "PSNR: " << 10.0 * log10(255.0 * 255.0 / meanSquaredError) << " dB" << std::endl;
     }
     else
     {
-        std::cout << "ERROR: Images have different dimensions" << std::endl;
+        std::cout << "PSNR: inf dB" << std::endl;
+    }
+    if (stats.differing > 0)
+    {
+        std::cout << "Differences between: (" << stats.top << "," << stats.left << ") and (";
+        std::cout << stats.bottom << "," << stats.right << ")" << std::endl;
     }
 }
 
+void printUsage(const char* program)
+{
+    std::cerr << "Usage: " << program << " [options] reference.png input.png" << std::endl;
+    std::cerr << "    -tolerance <n>  Let every channel differ by up to n (default 0)" << std::endl;
+    std::cerr << "    -threads <n>  Decode and compare with n threads (default 1)" << std::endl;
+    std::cerr << "    -list <n>  Print the first n pixels that differ (default 10)" << std::endl;
+    std::cerr << "Exits with 0 if the images match, 1 if they differ and 2 on errors." << std::endl;
+}
+
 int main(int argc, char* argv[])
 {
-    //Make sure the inputs are provided.
-    if(argc != 3)
+    int tolerance = 0;
+    int threads = 1;
+    int listLimit = 10;
+    const char* files[2];
+    int fileCount = 0;
+    for (int i = 1; i < argc; i++)
     {
-        std::cerr << "Usage: " << argv[0] << " input1.png input2.png" << std::endl;
-        return 1;
+        if (strcmp(argv[i], "-tolerance") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 0)
+        {
+            tolerance = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 1)
+        {
+            threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-list") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 0)
+        {
+            listLimit = atoi(argv[++i]);
+        }
+        else if (argv[i][0] != '-' && fileCount < 2)
+        {
+            files[fileCount++] = argv[i];
+        }
+        else
+        {
+            fileCount = -1;
+            break;
+        }
     }
 
-    Image inputImage1, inputImage2;
-    bool read1 = read_png_file(argv[1], &inputImage1);
-    bool read2 = read_png_file(argv[2], &inputImage2);
-
-    //Compare the images.
-    compare_images(&inputImage1, &inputImage2);
+    //Make sure the inputs are provided.
+    if (fileCount != 2)
+    {
+        printUsage(argv[0]);
+        return EXIT_ERROR;
+    }
 
-    if(read1) deleteImage(&inputImage1);
-    if(read2) deleteImage(&inputImage2);
-    return 0;
+    Image image1, image2;
+    int result = EXIT_ERROR;
+    Stats stats;
+    bool read1 = openImage(files[0], &image1);
+    bool read2 = openImage(files[1], &image2);
+    if (read1 && read2)
+    {
+        //Compare the images.
+        result = compareImages(&image1, &image2, tolerance, threads, listLimit, &stats);
+        if (result != EXIT_ERROR)
+        {
+            printStats(stats, image1.width, image1.height);
+        }
+    }
+    closeImage(&image1);
+    closeImage(&image2);
+    return result;
 }
@@ -0,0 +1,354 @@
+//This file contains microbenchmarks for the pieces that a render is made
+//of: shading single pixels that hit different kinds of objects, shading
+//rows, shading an image in each -order, converting pixels for the wire,
+//tone mapping and saving images.
+//
+//Every benchmark runs its operation in batches until it has run for long
+//enough, and reports the mean time per operation over the batches with
+//their standard deviation. The results are compared against a baseline
+//file, and a benchmark that got slower by more than the threshold (and by
+//more than three standard errors of the difference between the means) is
+//flagged as a regression. The program exits with 1 if anything regressed.
+//
+//Usage: raytrace_bench [-baseline <file>] [-update] [-filter <text>]
+//           [-threshold <percent>]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <mpi.h>
+
+#include "RayTrace.h"
+#include "image.h"
+#include "options.h"
+#include "shade.h"
+#include "tiles.h"
+#include "tone.h"
+#include "wire.h"
+
+//Every benchmark runs for at least this long, in at least this many
+//batches.
+#define MIN_SECONDS 0.5
+#define MIN_BATCHES 10
+#define MAX_BATCHES 1000
+
+//The result of one benchmark, in nanoseconds per operation.
+typedef struct
+{
+    std::string name;
+    double mean;
+    double deviation;
+    int batches;
+} Result;
+
+//A set of pixels that all hit the same kind of object. The pixels are a
+//square patch around a point given as a fraction of the width and height
+//of the image, so they hit the same thing at any image size.
+typedef struct
+{
+    const char* name;
+    float x, y;
+} PixelSet;
+
+#define PATCH_SIZE 4
+
+static const PixelSet twhittedSets[] = {
+    { "background", 0.85f, 0.08f },
+    { "mirror_sphere", 0.20f, 0.60f },
+    { "glass_sphere", 0.55f, 0.40f },
+    { "plane", 0.75f, 0.90f },
+};
+
+static const PixelSet boxSets[] = {
+    { "wall", 0.50f, 0.40f },
+    { "spheres", 0.33f, 0.78f },
+    { "ruby_mesh", 0.77f, 0.78f },
+    { "shadowed_floor", 0.50f, 0.87f },
+};
+
+static std::vector<Result> results;
+static const char* filter = NULL;
+
+//Runs an operation in batches and records its time per operation.
+//
+//Inputs:
+//    name - the name of the benchmark.
+//    operations - the number of operations that one call of batch runs.
+//    batch - the function that runs one batch.
+static void benchmark(const std::string& name, int operations, std::function<void()> batch)
+{
+    if (filter != NULL && name.find(filter) == std::string::npos)
+    {
+        return;
+    }
+
+    //Warm up the caches before timing anything.
+    batch();
+
+    std::vector<double> times;
+    double start = MPI_Wtime();
+    while ((times.size() < MIN_BATCHES || MPI_Wtime() - start < MIN_SECONDS) && times.size() < MAX_BATCHES)
+    {
+        double batchStart = MPI_Wtime();
+        batch();
+        times.push_back(1e9 * (MPI_Wtime() - batchStart) / operations);
+    }
+
+    Result result;
+    result.name = name;
+    result.mean = 0.0;
+    for (size_t i = 0; i < times.size(); i++)
+    {
+        result.mean += times[i];
+    }
+    result.mean /= times.size();
+    result.deviation = 0.0;
+    for (size_t i = 0; i < times.size(); i++)
+    {
+        result.deviation += (times[i] - result.mean) * (times[i] - result.mean);
+    }
+    result.deviation = sqrt(result.deviation / (times.size() - 1));
+    result.batches = times.size();
+    results.push_back(result);
+    std::cerr << "    " << name << std::endl;
+}
+
+//Loads a scene with initialize(), the same way the ray tracers do.
+static bool loadScene(const char* config, int width, int height, ConfigData* data)
+{
+    std::ostringstream widthText, heightText;
+    widthText << width;
+    heightText << height;
+    std::string w = widthText.str(), h = heightText.str();
+    const char* args[] = { "raytrace_bench", "-c", config, "-w", w.c_str(), "-h", h.c_str(), "-p", "none", NULL };
+    int argc = 9;
+    char** argv = (char**)args;
+    if (initialize(&argc, &argv, data))
+    {
+        std::cerr << "Could not load " << config << std::endl;
+        return false;
+    }
+    data->mpi_rank = 0;
+    data->mpi_procs = 1;
+    return true;
+}
+
+//Benchmarks shadePixel() on every pixel set of a scene.
+static void shadeSets(const char* scene, const PixelSet* sets, int count, ConfigData* data)
+{
+    for (int i = 0; i < count; i++)
+    {
+        int column = (int)(sets[i].x * data->width) - PATCH_SIZE / 2;
+        int row = (int)(sets[i].y * data->height) - PATCH_SIZE / 2;
+        benchmark(std::string("shadePixel/") + scene + "/" + sets[i].name, PATCH_SIZE * PATCH_SIZE, [=] {
+            float color[3];
+            for (int y = row; y < row + PATCH_SIZE; y++)
+            {
+                for (int x = column; x < column + PATCH_SIZE; x++)
+                {
+                    shadePixel(color, y, x, data);
+                }
+            }
+        });
+    }
+}
+
+//Returns the standard error of the mean of a result.
+static double standardError(const Result& result)
+{
+    return result.deviation / sqrt((double)result.batches);
+}
+
+//Reads a baseline file of "name mean deviation batches" lines.
+static std::map<std::string, Result> readBaseline(const char* file)
+{
+    std::map<std::string, Result> baseline;
+    std::ifstream stream(file);
+    Result result;
+    while (stream >> result.name >> result.mean >> result.deviation >> result.batches)
+    {
+        baseline[result.name] = result;
+    }
+    return baseline;
+}
+
+static void writeBaseline(const char* file)
+{
+    std::ofstream stream(file);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        stream << results[i].name << " " << results[i].mean << " " << results[i].deviation << " ";
+        stream << results[i].batches << std::endl;
+    }
+    if (!stream)
+    {
+        std::cerr << "Could not write the baseline to " << file << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const char* baselineFile = NULL;
+    bool update = false;
+    double threshold = 10.0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-baseline") == 0 && i + 1 < argc)
+        {
+            baselineFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "-update") == 0)
+        {
+            update = true;
+        }
+        else if (strcmp(argv[i], "-filter") == 0 && i + 1 < argc)
+        {
+            filter = argv[++i];
+        }
+        else if (strcmp(argv[i], "-threshold") == 0 && i + 1 < argc)
+        {
+            threshold = atof(argv[++i]);
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [-baseline <file>] [-update] [-filter <text>] [-threshold <percent>]" << std::endl;
+            return 2;
+        }
+    }
+
+    //MPI is only needed for the timer and for combining the luminance.
+    MPI_Init(&argc, &argv);
+
+    std::cerr << "Running:" << std::endl;
+    ConfigData twhitted, box;
+    if (!loadScene("configs/twhitted.xml", 400, 300, &twhitted) || !loadScene("configs/box.xml", 300, 300, &box))
+    {
+        MPI_Finalize();
+        return 2;
+    }
+    shadeSets("twhitted", twhittedSets, sizeof(twhittedSets) / sizeof(twhittedSets[0]), &twhitted);
+    shadeSets("box", boxSets, sizeof(boxSets) / sizeof(boxSets[0]), &box);
+
+    //One row through the middle of the image, which hits a bit of everything.
+    std::vector<float> row(3 * twhitted.width);
+    benchmark("shadeSpan/twhitted/middle_row", twhitted.width, [&] {
+        shadeSpan(&row[0], twhitted.height / 2, 0, twhitted.width, &twhitted);
+    });
+
+    //Shade the whole of the mesh scene in every order. Only the order of the
+    //rays changes, so any difference comes from how well the caches hold
+    //the triangles and bounding boxes that neighbouring rays share.
+    const TileOrder orders[] = { ORDER_ROWS, ORDER_MORTON, ORDER_HILBERT };
+    const char* orderNames[] = { "rows", "morton", "hilbert" };
+    std::vector<float> boxImage(3 * box.width * box.height);
+    for (int i = 0; i < 3; i++)
+    {
+        //The same pieces, in the same order, as shadeRegion() shades.
+        std::vector<Tile> cells = regionCells(box.width, box.height, orders[i]);
+        benchmark(std::string("shadeOrder/box/") + orderNames[i], box.width * box.height, [&] {
+            for (size_t j = 0; j < cells.size(); j++)
+            {
+                shadeTile(&boxImage[3 * (cells[j].row * box.width + cells[j].column)], cells[j].row,
+                    cells[j].column, cells[j].width, cells[j].height, box.width, &box);
+            }
+        });
+    }
+
+    //The rest work on a whole rendered image.
+    int count = 3 * twhitted.width * twhitted.height;
+    std::vector<float> image(count), copy(count);
+    shadeTile(&image[0], 0, 0, twhitted.width, twhitted.height, twhitted.width, &twhitted);
+
+    std::vector<unsigned char> wire(count * sizeof(float));
+    const WireFormat formats[] = { WIRE_HALF, WIRE_BYTE };
+    const char* formatNames[] = { "half", "byte" };
+    for (int i = 0; i < 2; i++)
+    {
+        renderOptions.wireFormat = formats[i];
+        benchmark(std::string("encodePixels/") + formatNames[i], count, [&] {
+            encodePixels(&image[0], &wire[0], count);
+        });
+        benchmark(std::string("decodePixels/") + formatNames[i], count, [&] {
+            decodePixels(&wire[0], &copy[0], count);
+        });
+    }
+    renderOptions.wireFormat = WIRE_FLOAT;
+
+    const char* operators[] = { "reinhard", "ward" };
+    for (int i = 0; i < 2; i++)
+    {
+        renderOptions.toneOperator = operators[i];
+        benchmark(std::string("toneMap/") + operators[i], count / 3, [&] {
+            copy = image;
+            measureLuminance(&copy[0], twhitted.width, twhitted.height, twhitted.width);
+            combineLuminance();
+            toneMapRegion(&copy[0], twhitted.width, twhitted.height, twhitted.width);
+        });
+    }
+    renderOptions.toneOperator = NULL;
+
+    std::string file = "/tmp/raytrace_bench.png";
+    benchmark("writeRows/png", count / 3, [&] {
+        ImageWriter* writer = openImage(file, &twhitted);
+        if (writer != NULL)
+        {
+            writeRows(writer, &image[0], twhitted.height);
+            closeImage(writer);
+        }
+    });
+    benchmark("savePixels/png", count / 3, [&] {
+        savePixels(file, &image[0], &twhitted);
+    });
+    remove(file.c_str());
+
+    shutdown(&twhitted);
+    shutdown(&box);
+
+    //Compare against the baseline and print the table.
+    std::map<std::string, Result> baseline;
+    if (baselineFile != NULL)
+    {
+        baseline = readBaseline(baselineFile);
+    }
+    int regressions = 0;
+    printf("%-36s %14s %9s %14s %9s\n", "Benchmark", "ns/op", "+/-", "Baseline", "Change");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const Result& result = results[i];
+        printf("%-36s %14.1f %8.1f%%", result.name.c_str(), result.mean, 100.0 * result.deviation / result.mean);
+        std::map<std::string, Result>::iterator old = baseline.find(result.name);
+        if (old == baseline.end())
+        {
+            printf("\n");
+            continue;
+        }
+        double change = 100.0 * (result.mean - old->second.mean) / old->second.mean;
+        //The difference also has to be well outside the noise of both means.
+        double noise = 3.0 * hypot(standardError(result), standardError(old->second));
+        bool regressed = change > threshold && result.mean - old->second.mean > noise;
+        printf(" %14.1f %+8.1f%%%s\n", old->second.mean, change, regressed ? "  REGRESSION" : "");
+        regressions += regressed ? 1 : 0;
+    }
+
+    if (baselineFile != NULL && (update || baseline.empty()))
+    {
+        writeBaseline(baselineFile);
+        printf("Saved the baseline to %s\n", baselineFile);
+    }
+    else if (regressions > 0)
+    {
+        printf("%d benchmarks are more than %.0f%% slower than the baseline.\n", regressions, threshold);
+    }
+
+    MPI_Finalize();
+    return regressions > 0 && !update ? 1 : 0;
+}
@@ -0,0 +1,299 @@
+//This file contains the code that moves pixels between processes in the
+//selected wire format.
+
+#include <cstring>
+#include <vector>
+#include <mpi.h>
+
+#include "RayTrace.h"
+#include "image.h"
+#include "options.h"
+#include "wire.h"
+
+//Converts a float to a half float, rounding to the nearest value.
+static unsigned short floatToHalf(float value)
+{
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    unsigned short sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    unsigned int mantissa = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff)
+    {
+        //Infinity stays infinity and NaN stays NaN.
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    }
+    if (exponent >= 0x1f)
+    {
+        //Too large for a half float.
+        return sign | 0x7c00;
+    }
+    if (exponent <= 0)
+    {
+        //Denormal half float, or too small and flushed to zero.
+        if (exponent < -10)
+        {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        unsigned int half = mantissa >> shift;
+        unsigned int rest = mantissa & ((1u << shift) - 1);
+        unsigned int halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+        {
+            half++;
+        }
+        return sign | half;
+    }
+
+    unsigned int half = ((unsigned int)exponent << 10) | (mantissa >> 13);
+    unsigned int rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+    {
+        //Rounding up may carry into the exponent, which is still correct.
+        half++;
+    }
+    return sign | half;
+}
+
+//Converts a half float back to a float. Every half float is exact as a float.
+static float halfToFloat(unsigned short half)
+{
+    unsigned int sign = (unsigned int)(half & 0x8000) << 16;
+    unsigned int exponent = (half >> 10) & 0x1f;
+    unsigned int mantissa = half & 0x3ff;
+    unsigned int bits;
+
+    if (exponent == 0x1f)
+    {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else if (exponent != 0)
+    {
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+    else if (mantissa == 0)
+    {
+        bits = sign;
+    }
+    else
+    {
+        //Normalize the denormal half float.
+        exponent = 127 - 15 + 1;
+        while ((mantissa & 0x400) == 0)
+        {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+MPI_Datatype wireElement()
+{
+    switch (renderOptions.wireFormat)
+    {
+        case WIRE_HALF:
+            return MPI_UNSIGNED_SHORT;
+        case WIRE_BYTE:
+            return MPI_UNSIGNED_CHAR;
+        default:
+            return MPI_FLOAT;
+    }
+}
+
+void encodePixels(const float* pixels, void* wire, int count)
+{
+    switch (renderOptions.wireFormat)
+    {
+        case WIRE_HALF:
+            for (int i = 0; i < count; i++)
+            {
+                ((unsigned short*)wire)[i] = floatToHalf(pixels[i]);
+            }
+            break;
+        case WIRE_BYTE:
+            for (int i = 0; i < count; i++)
+            {
+                ((unsigned char*)wire)[i] = channelToByte(pixels[i]);
+            }
+            break;
+        default:
+            memcpy(wire, pixels, count * sizeof(float));
+            break;
+    }
+}
+
+void decodePixels(const void* wire, float* pixels, int count)
+{
+    switch (renderOptions.wireFormat)
+    {
+        case WIRE_HALF:
+            for (int i = 0; i < count; i++)
+            {
+                pixels[i] = halfToFloat(((const unsigned short*)wire)[i]);
+            }
+            break;
+        case WIRE_BYTE:
+            //Land in the middle of the range that converts back to the
+            //same 8-bit value, so that saving the image gives that value.
+            for (int i = 0; i < count; i++)
+            {
+                pixels[i] = (((const unsigned char*)wire)[i] + 0.5f) / 255.0f;
+            }
+            break;
+        default:
+            memcpy(pixels, wire, count * sizeof(float));
+            break;
+    }
+}
+
+//Returns the number of color channels in count elements of the type.
+static int channelCount(int count, MPI_Datatype type)
+{
+    int size;
+    MPI_Type_size(type, &size);
+    return count * (size / (int)sizeof(float));
+}
+
+static int wireSize()
+{
+    int size;
+    MPI_Type_size(wireElement(), &size);
+    return size;
+}
+
+void startSendPixels(float* pixels, int count, MPI_Datatype type, int dest,
+    int tag, PixelTransfer* transfer)
+{
+    transfer->receiving = false;
+    if (renderOptions.wireFormat == WIRE_FLOAT)
+    {
+        MPI_Isend(pixels, count, type, dest, tag, MPI_COMM_WORLD, &transfer->request);
+        return;
+    }
+
+    //Line the pixels up in the order of the type, then convert them.
+    int channels = channelCount(count, type);
+    std::vector<float> packed;
+    float* source = pixels;
+    if (type != MPI_FLOAT)
+    {
+        packed.resize(channels);
+        source = packed.empty() ? NULL : &packed[0];
+        MPI_Sendrecv(pixels, count, type, 0, 0, source, channels, MPI_FLOAT, 0, 0,
+            MPI_COMM_SELF, MPI_STATUS_IGNORE);
+    }
+    transfer->wire.resize(channels * wireSize());
+    unsigned char* wire = transfer->wire.empty() ? NULL : &transfer->wire[0];
+    encodePixels(source, wire, channels);
+    MPI_Isend(wire, channels, wireElement(), dest, tag, MPI_COMM_WORLD, &transfer->request);
+}
+
+void startReceivePixels(float* pixels, int count, MPI_Datatype type, int source,
+    int tag, PixelTransfer* transfer)
+{
+    transfer->receiving = true;
+    transfer->pixels = pixels;
+    transfer->count = count;
+    transfer->type = type;
+    if (renderOptions.wireFormat == WIRE_FLOAT)
+    {
+        MPI_Irecv(pixels, count, type, source, tag, MPI_COMM_WORLD, &transfer->request);
+        return;
+    }
+
+    int channels = channelCount(count, type);
+    transfer->wire.resize(channels * wireSize());
+    MPI_Irecv(transfer->wire.empty() ? NULL : &transfer->wire[0], channels, wireElement(),
+        source, tag, MPI_COMM_WORLD, &transfer->request);
+}
+
+//Converts the pixels of a receive that has completed and puts them where
+//its type says. Sends and float receives have nothing left to do.
+static void placePixels(PixelTransfer* transfer)
+{
+    if (!transfer->receiving || renderOptions.wireFormat == WIRE_FLOAT)
+    {
+        return;
+    }
+    int channels = channelCount(transfer->count, transfer->type);
+    unsigned char* wire = transfer->wire.empty() ? NULL : &transfer->wire[0];
+    if (transfer->type == MPI_FLOAT)
+    {
+        decodePixels(wire, transfer->pixels, channels);
+        return;
+    }
+    std::vector<float> packed(channels);
+    float* decoded = packed.empty() ? NULL : &packed[0];
+    decodePixels(wire, decoded, channels);
+    MPI_Sendrecv(decoded, channels, MPI_FLOAT, 0, 0, transfer->pixels, transfer->count,
+        transfer->type, 0, 0, MPI_COMM_SELF, MPI_STATUS_IGNORE);
+}
+
+void finishPixels(PixelTransfer* transfers, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        MPI_Wait(&transfers[i].request, MPI_STATUS_IGNORE);
+        placePixels(&transfers[i]);
+    }
+}
+
+//Waits for, or only checks for, any one of the transfers to complete.
+static int completeAny(PixelTransfer* transfers, int count, bool wait)
+{
+    std::vector<MPI_Request> requests(count);
+    for (int i = 0; i < count; i++)
+    {
+        requests[i] = transfers[i].request;
+    }
+    int index = MPI_UNDEFINED, done;
+    if (count > 0 && wait)
+    {
+        MPI_Waitany(count, &requests[0], &index, MPI_STATUS_IGNORE);
+    }
+    else if (count > 0)
+    {
+        MPI_Testany(count, &requests[0], &index, &done, MPI_STATUS_IGNORE);
+    }
+    if (index == MPI_UNDEFINED)
+    {
+        return MPI_UNDEFINED;
+    }
+
+    //MPI has released the request, so the transfer must not wait on it again.
+    transfers[index].request = requests[index];
+    placePixels(&transfers[index]);
+    return index;
+}
+
+int finishAnyPixels(PixelTransfer* transfers, int count)
+{
+    return completeAny(transfers, count, true);
+}
+
+int testAnyPixels(PixelTransfer* transfers, int count)
+{
+    return completeAny(transfers, count, false);
+}
+
+void sendPixels(float* pixels, int count, MPI_Datatype type, int dest, int tag)
+{
+    PixelTransfer transfer;
+    startSendPixels(pixels, count, type, dest, tag, &transfer);
+    finishPixels(&transfer, 1);
+}
+
+void receivePixels(float* pixels, int count, MPI_Datatype type, int source, int tag)
+{
+    PixelTransfer transfer;
+    startReceivePixels(pixels, count, type, source, tag, &transfer);
+    finishPixels(&transfer, 1);
+}